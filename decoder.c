@@ -235,28 +235,18 @@ err_out:
 	return ret;
 }
 
-/**
- * Load a protocol decoder module into the embedded Python interpreter.
- *
- * @param module_name The module name to be loaded.
- *
- * @return SRD_OK upon success, a (negative) error code otherwise.
- *
- * @since 0.1.0
- */
-SRD_API int srd_decoder_load(const char *module_name)
+/* Load the module, with the Python interpreter lock held. */
+static int decoder_load(const char *module_name)
 {
 	PyObject *py_basedec, *py_method, *py_attr, *py_annlist, *py_ann, \
 		*py_bin_classes, *py_bin_class;
 	struct srd_decoder *d;
 	int len, ret, i;
 	char **ann, *bin;
+	const char *method;
 	struct srd_probe *p;
 	GSList *l;
 
-	if (!srd_check_init())
-		return SRD_ERR;
-
 	if (!module_name)
 		return SRD_ERR_ARG;
 
@@ -318,16 +308,26 @@ SRD_API int srd_decoder_load(const char *module_name)
 	}
 	Py_CLEAR(py_method);
 
-	/* Check for a proper decode() method. */
-	if (!PyObject_HasAttrString(d->py_dec, "decode")) {
+	/*
+	 * Check for a proper decode() method, or a decode_block() method
+	 * which takes whole chunks instead, or a decode_batch() method which
+	 * takes the packets of a stacked PD a chunk at a time.
+	 */
+	if (PyObject_HasAttrString(d->py_dec, "decode_block"))
+		method = "decode_block";
+	else if (PyObject_HasAttrString(d->py_dec, "decode_batch"))
+		method = "decode_batch";
+	else
+		method = "decode";
+	if (!PyObject_HasAttrString(d->py_dec, method)) {
 		srd_err("Protocol decoder %s has no decode() method Decoder "
 			"class.", module_name);
 		goto err_out;
 	}
-	py_method = PyObject_GetAttrString(d->py_dec, "decode");
+	py_method = PyObject_GetAttrString(d->py_dec, method);
 	if (!PyFunction_Check(py_method)) {
-		srd_err("Protocol decoder %s Decoder class attribute 'decode' "
-			"is not a method.", module_name);
+		srd_err("Protocol decoder %s Decoder class attribute '%s' "
+			"is not a method.", module_name, method);
 		goto err_out;
 	}
 	Py_CLEAR(py_method);
@@ -440,6 +440,30 @@ err_out:
 	return ret;
 }
 
+/**
+ * Load a protocol decoder module into the embedded Python interpreter.
+ *
+ * @param module_name The module name to be loaded.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.1.0
+ */
+SRD_API int srd_decoder_load(const char *module_name)
+{
+	PyGILState_STATE gstate;
+	int ret;
+
+	if (!srd_check_init())
+		return SRD_ERR;
+
+	gstate = PyGILState_Ensure();
+	ret = decoder_load(module_name);
+	PyGILState_Release(gstate);
+
+	return ret;
+}
+
 /**
  * Return a protocol decoder's docstring.
  *
@@ -452,6 +476,7 @@ err_out:
  */
 SRD_API char *srd_decoder_doc_get(const struct srd_decoder *dec)
 {
+	PyGILState_STATE gstate;
 	PyObject *py_str;
 	char *doc;
 
@@ -461,18 +486,23 @@ SRD_API char *srd_decoder_doc_get(const struct srd_decoder *dec)
 	if (!dec)
 		return NULL;
 
-	if (!PyObject_HasAttrString(dec->py_mod, "__doc__"))
+	doc = NULL;
+	gstate = PyGILState_Ensure();
+	if (!PyObject_HasAttrString(dec->py_mod, "__doc__")) {
+		PyGILState_Release(gstate);
 		return NULL;
+	}
 
 	if (!(py_str = PyObject_GetAttrString(dec->py_mod, "__doc__"))) {
 		srd_exception_catch("");
+		PyGILState_Release(gstate);
 		return NULL;
 	}
 
-	doc = NULL;
 	if (py_str != Py_None)
 		py_str_as_str(py_str, &doc);
 	Py_DecRef(py_str);
+	PyGILState_Release(gstate);
 
 	return doc;
 }
@@ -506,6 +536,7 @@ static void free_probes(GSList *probelist)
  */
 SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 {
+	PyGILState_STATE gstate;
 	struct srd_decoder_option *o;
 	struct srd_session *sess;
 	GSList *l;
@@ -524,6 +555,9 @@ SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 	 * stack. A frontend reloading a decoder thus has to restart all
 	 * instances, and rebuild the stack.
 	 */
+	for (l = sessions; l; l = l->next)
+		session_async_idle(l->data);
+	gstate = PyGILState_Ensure();
 	for (l = sessions; l; l = l->next) {
 		sess = l->data;
 		srd_inst_free_all(sess, NULL);
@@ -550,6 +584,7 @@ SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 	Py_XDECREF(dec->py_dec);
 	/* The module itself. */
 	Py_XDECREF(dec->py_mod);
+	PyGILState_Release(gstate);
 
 	g_free(dec);
 
@@ -36,6 +36,7 @@ class Decoder(srd.Decoder):
     license = 'gplv2+'
     inputs = ['logic']
     outputs = ['dcf77']
+    edges_only = True
     probes = [
         {'id': 'data', 'name': 'DATA', 'desc': 'DATA line'},
     ]
@@ -49,24 +49,30 @@ class Decoder(srd.Decoder):
         self.first_transition = True
         self.bitwidth = None
 
-    def start(self, metadata):
-        self.samplerate = metadata['samplerate']
+    def start(self):
         # self.out_proto = self.register(srd.OUTPUT_PYTHON)
         self.out_ann = self.register(srd.OUTPUT_ANN)
 
-    def decode(self, ss, es, data):
-        for (self.samplenum, pins) in data:
+    def metadata(self, key, value):
+        if key == srd.SRD_CONF_SAMPLERATE:
+            self.samplerate = value
 
-            data = pins[0]
+    def decode_block(self, ss, es, samples):
+        data = samples[0]
+        if not data:
+            return
 
-            # Wait for any transition on the data line.
-            if data == self.olddata:
-                continue
+        # Initialize first self.olddata with the first sample value.
+        if self.olddata == None:
+            self.olddata = data[0]
 
-            # Initialize first self.olddata with the first sample value.
-            if self.olddata == None:
-                self.olddata = data
-                continue
+        pos = 0
+        while True:
+            # Find the next transition on the data line.
+            pos = data.find(b'\x00' if self.olddata else b'\x01', pos)
+            if pos == -1:
+                break
+            self.samplenum = ss + pos
 
             # Get the smallest distance between two transitions
             # and use that to calculate the bitrate/baudrate.
@@ -81,5 +87,4 @@ class Decoder(srd.Decoder):
                     self.putx([0, ['%d' % bitrate]])
                 self.ss_edge = self.samplenum
 
-            self.olddata = data
-
+            self.olddata = data[pos]
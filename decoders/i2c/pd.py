@@ -31,7 +31,10 @@ import sigrokdecode as srd
 Protocol output format:
 
 I2C packet:
-[<cmd>, <data>]
+srd.I2CPacket(<cmd>, <data>)
+
+It unpacks like the list [<cmd>, <data>], and has the attributes cmd,
+databyte, and code, which is <cmd> as one of the srd.CMD_* constants.
 
 <cmd> is one of:
  - 'START' (START condition)
@@ -72,6 +75,7 @@ class Decoder(srd.Decoder):
     license = 'gplv2+'
     inputs = ['logic']
     outputs = ['i2c']
+    edges_only = True
     probes = [
         {'id': 'scl', 'name': 'SCL', 'desc': 'Serial clock line'},
         {'id': 'sda', 'name': 'SDA', 'desc': 'Serial data line'},
@@ -157,7 +161,7 @@ class Decoder(srd.Decoder):
         self.pdu_start = self.samplenum
         self.pdu_bits = 0
         cmd = 'START REPEAT' if (self.is_repeat_start == 1) else 'START'
-        self.putp([cmd, None])
+        self.putp(srd.I2CPacket(cmd, None))
         self.putx([proto[cmd][0], proto[cmd][1:]])
         self.state = 'FIND ADDRESS'
         self.bitcount = self.databyte = 0
@@ -202,7 +206,7 @@ class Decoder(srd.Decoder):
             cmd = 'DATA READ'
             bin_class = 2
 
-        self.putp([cmd, d])
+        self.putp(srd.I2CPacket(cmd, d))
         self.putx([proto[cmd][0], ['%s: %02X' % (proto[cmd][1], d),
                   '%s: %02X' % (proto[cmd][2], d), '%02X' % d]])
         self.putb((bin_class, bytes([d])))
@@ -215,7 +219,7 @@ class Decoder(srd.Decoder):
     def get_ack(self, scl, sda):
         self.startsample = self.samplenum
         cmd = 'NACK' if (sda == 1) else 'ACK'
-        self.putp([cmd, None])
+        self.putp(srd.I2CPacket(cmd, None))
         self.putx([proto[cmd][0], proto[cmd][1:]])
         # There could be multiple data bytes in a row, so either find
         # another data byte or a STOP condition next.
@@ -229,7 +233,7 @@ class Decoder(srd.Decoder):
 
         self.startsample = self.samplenum
         cmd = 'STOP'
-        self.putp([cmd, None])
+        self.putp(srd.I2CPacket(cmd, None))
         self.putx([proto[cmd][0], proto[cmd][1:]])
         self.state = 'FIND START'
         self.is_repeat_start = 0
@@ -53,12 +53,13 @@ class Decoder(srd.Decoder):
     # get the whole chunk of packets (from START to STOP).
     def decode(self, ss, es, data):
 
-        cmd, databyte = data
+        code = data.code
 
         # Add the I2C packet to our local cache.
         self.packets.append([ss, es, data])
 
-        if cmd in ('ADDRESS READ', 'ADDRESS WRITE'):
+        if code in (srd.CMD_ADDRESS_READ, srd.CMD_ADDRESS_WRITE):
+            databyte = data.databyte
             if databyte in self.slaves:
                 self.stream = self.slaves.index(databyte)
                 return
@@ -69,7 +70,7 @@ class Decoder(srd.Decoder):
                                   proto_id='i2c-%s' % hex(databyte)))
             self.stream = self.streamcount
             self.streamcount += 1
-        elif cmd == 'STOP':
+        elif code == srd.CMD_STOP:
             if self.stream == -1:
                 raise Exception('Invalid stream!') # FIXME?
 
@@ -82,3 +83,8 @@ class Decoder(srd.Decoder):
         else:
             pass # Do nothing, only add the I2C packet to our cache.
 
+
+    # Take all packets the I2C decoder found in a chunk at once.
+    def decode_batch(self, packets):
+        for ss, es, data in packets:
+            self.decode(ss, es, data)
@@ -106,6 +106,7 @@ class Decoder(srd.Decoder):
     license = 'gplv2+'
     inputs = ['logic']
     outputs = ['lpc']
+    edges_only = True
     probes = [
         {'id': 'lframe', 'name': 'LFRAME#', 'desc': 'TODO'},
         {'id': 'lclk',   'name': 'LCLK',    'desc': 'TODO'},
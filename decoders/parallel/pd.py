@@ -72,6 +72,7 @@ class Decoder(srd.Decoder):
     license = 'gplv2+'
     inputs = ['logic']
     outputs = ['parallel']
+    edges_only = True
     probes = [
         {'id': 'clk', 'name': 'CLK', 'desc': 'Clock line'},
     ]
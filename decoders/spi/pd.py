@@ -27,10 +27,14 @@ import sigrokdecode as srd
 Protocol output format:
 
 SPI packet:
-[<cmd>, <data1>, <data2>]
+srd.SPIPacket(<cmd>, <data1>, <data2>)
+
+It unpacks like the list [<cmd>, <data1>, <data2>], and has the attributes
+cmd, mosi (<data1>), miso (<data2>), and code, which is <cmd> as one of the
+srd.CMD_* constants.
 
 Commands:
- - 'DATA': <data1> contains the MISO data, <data2> contains the MOSI data.
+ - 'DATA': <data1> contains the MOSI data, <data2> contains the MISO data.
    The data is _usually_ 8 bits (but can also be fewer or more bits).
    Both data items are Python numbers, not strings.
  - 'CS CHANGE': <data1> is the old CS# pin value, <data2> is the new value.
@@ -62,6 +66,7 @@ class Decoder(srd.Decoder):
     license = 'gplv2+'
     inputs = ['logic']
     outputs = ['spi']
+    edges_only = True
     probes = [
         {'id': 'miso', 'name': 'MISO',
          'desc': 'SPI MISO line (Master in, slave out)'},
@@ -147,7 +152,7 @@ class Decoder(srd.Decoder):
             return
 
         # Pass MOSI and MISO to the next PD up the stack
-        self.putpw(['DATA', self.mosidata, self.misodata])
+        self.putpw(srd.SPIPacket('DATA', self.mosidata, self.misodata))
 
         # Annotations
         self.putw([0, ['%02X/%02X' % (self.mosidata, self.misodata)]])
@@ -169,7 +174,7 @@ class Decoder(srd.Decoder):
         if self.have_cs and self.oldcs != cs:
             # Send all CS# pin value changes.
             self.put(self.samplenum, self.samplenum, self.out_proto,
-                     ['CS-CHANGE', self.oldcs, cs])
+                     srd.SPIPacket('CS-CHANGE', self.oldcs, cs))
             self.oldcs = cs
             # Reset decoder state when CS# changes (and the CS# pin is used).
             self.mosidata = self.misodata = self.bitcount= 0
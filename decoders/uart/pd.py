@@ -26,7 +26,11 @@ import sigrokdecode as srd
 Protocol output format:
 
 UART packet:
-[<packet-type>, <rxtx>, <packet-data>]
+srd.UARTPacket(<packet-type>, <rxtx>, <packet-data>)
+
+It unpacks like the list [<packet-type>, <rxtx>, <packet-data>], and has the
+attributes cmd (<packet-type>), rxtx, data (<packet-data>), and code, which is
+<packet-type> as one of the srd.CMD_* constants.
 
 This is the list of <packet-type>s and their respective <packet-data>:
  - 'STARTBIT': The data is the (integer) value of the start bit (0/1).
@@ -140,6 +144,11 @@ class Decoder(srd.Decoder):
             self.samplerate = value;
             # The width of one UART bit in number of samples.
             self.bit_width = float(self.samplerate) / float(self.options['baudrate'])
+            # Starting mid-frame, decoding resyncs on the first start bit
+            # after the line was idle, which can take a few frames when
+            # they follow back to back. Allow for 8 of the longest frames
+            # (start bit, 9 data bits, parity bit, 2 stop bits).
+            self.preroll = int(self.bit_width * 8 * 13)
 
     # Return true if we reached the middle of the desired bit, false otherwise.
     def reached_bit(self, rxtx, bitnum):
@@ -178,7 +187,8 @@ class Decoder(srd.Decoder):
 
         # The startbit must be 0. If not, we report an error.
         if self.startbit[rxtx] != 0:
-            self.putp(['INVALID STARTBIT', rxtx, self.startbit[rxtx]])
+            self.putp(srd.UARTPacket('INVALID STARTBIT', rxtx,
+                                     self.startbit[rxtx]))
             # TODO: Abort? Ignore rest of the frame?
 
         self.cur_data_bit[rxtx] = 0
@@ -187,7 +197,7 @@ class Decoder(srd.Decoder):
 
         self.state[rxtx] = 'GET DATA BITS'
 
-        self.putp(['STARTBIT', rxtx, self.startbit[rxtx]])
+        self.putp(srd.UARTPacket('STARTBIT', rxtx, self.startbit[rxtx]))
         self.putg([2, ['Start bit', 'Start', 'S']])
 
     def get_data_bits(self, rxtx, signal):
@@ -218,7 +228,7 @@ class Decoder(srd.Decoder):
 
         self.state[rxtx] = 'GET PARITY BIT'
 
-        self.putp(['DATA', rxtx, self.databyte[rxtx]])
+        self.putp(srd.UARTPacket('DATA', rxtx, self.databyte[rxtx]))
 
         b, f = self.databyte[rxtx], self.options['format']
         if f == 'ascii':
@@ -251,11 +261,12 @@ class Decoder(srd.Decoder):
 
         if parity_ok(self.options['parity_type'], self.paritybit[rxtx],
                      self.databyte[rxtx], self.options['num_data_bits']):
-            self.putp(['PARITYBIT', rxtx, self.paritybit[rxtx]])
+            self.putp(srd.UARTPacket('PARITYBIT', rxtx, self.paritybit[rxtx]))
             self.putg([3, ['Parity bit', 'Parity', 'P']])
         else:
             # TODO: Return expected/actual parity values.
-            self.putp(['PARITY ERROR', rxtx, (0, 1)]) # FIXME: Dummy tuple...
+            # FIXME: Dummy tuple...
+            self.putp(srd.UARTPacket('PARITY ERROR', rxtx, (0, 1)))
             self.putg([5, ['Parity error', 'Parity err', 'PE']])
 
     # TODO: Currently only supports 1 stop bit.
@@ -270,13 +281,14 @@ class Decoder(srd.Decoder):
 
         # Stop bits must be 1. If not, we report an error.
         if self.stopbit1[rxtx] != 1:
-            self.putp(['INVALID STOPBIT', rxtx, self.stopbit1[rxtx]])
+            self.putp(srd.UARTPacket('INVALID STOPBIT', rxtx,
+                                     self.stopbit1[rxtx]))
             self.putg([5, ['Frame error', 'Frame err', 'FE']])
             # TODO: Abort? Ignore the frame? Other?
 
         self.state[rxtx] = 'WAIT FOR START BIT'
 
-        self.putp(['STOPBIT', rxtx, self.stopbit1[rxtx]])
+        self.putp(srd.UARTPacket('STOPBIT', rxtx, self.stopbit1[rxtx]))
         self.putg([4, ['Stop bit', 'Stop', 'T']])
 
     def decode(self, ss, es, data):
@@ -215,9 +215,12 @@ class Decoder(srd.Decoder):
                 sym = symbols[self.options['signalling']][tuple(pins)]
                 self.wait_for_sop(sym)
             elif self.state in ('GET BIT', 'GET EOP'):
-                # Wait until we're in the middle of the desired bit.
+                # Skip ahead to the middle of the desired bit.
                 if self.samplenum < self.samplenum_target:
-                    continue
+                    target = data.skip(self.samplenum_target)
+                    if target is None:
+                        return
+                    (self.samplenum, pins) = target
                 sym = symbols[self.options['signalling']][tuple(pins)]
                 if self.state == 'GET BIT':
                     self.get_bit(sym)
@@ -25,14 +25,28 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 /** @cond PRIVATE */
 
-extern GSList *sessions;
+/* type_decoder.c */
+extern SRD_PRIV PyTypeObject srd_Decoder_type;
 
 /* type_logic.c */
 extern SRD_PRIV PyTypeObject srd_logic_type;
 
+/*
+ * Instances with up to this many mapped probes get a prebuilt bytes
+ * object for each possible sample value.
+ */
+#define MAX_PREBUILT_PROBES 8
+
+/*
+ * The most samples handed to a PD's decode_block() in one call, which
+ * expands them to a byte per sample and probe.
+ */
+#define BLOCK_MAX_SAMPLES (1024 * 1024)
+
 /** @endcond */
 
 /**
@@ -49,20 +63,8 @@ extern SRD_PRIV PyTypeObject srd_logic_type;
  * @{
  */
 
-/**
- * Set one or more options in a decoder instance.
- *
- * Handled options are removed from the hash.
- *
- * @param di Decoder instance.
- * @param options A GHashTable of options to set.
- *
- * @return SRD_OK upon success, a (negative) error code otherwise.
- *
- * @since 0.1.0
- */
-SRD_API int srd_inst_option_set(struct srd_decoder_inst *di,
-		GHashTable *options)
+/* Set the options, with the Python interpreter lock held. */
+static int inst_option_set(struct srd_decoder_inst *di, GHashTable *options)
 {
 	PyObject *py_dec_options, *py_dec_optkeys, *py_di_options, *py_optval;
 	PyObject *py_optlist, *py_classval;
@@ -74,11 +76,6 @@ SRD_API int srd_inst_option_set(struct srd_decoder_inst *di,
 	const char *val_str;
 	char *dbg, *key;
 
-	if (!di) {
-		srd_err("Invalid decoder instance.");
-		return SRD_ERR_ARG;
-	}
-
 	if (!options) {
 		srd_err("Invalid options GHashTable.");
 		return SRD_ERR_ARG;
@@ -208,6 +205,37 @@ err_out:
 	return ret;
 }
 
+/**
+ * Set one or more options in a decoder instance.
+ *
+ * Handled options are removed from the hash.
+ *
+ * @param di Decoder instance.
+ * @param options A GHashTable of options to set.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.1.0
+ */
+SRD_API int srd_inst_option_set(struct srd_decoder_inst *di,
+		GHashTable *options)
+{
+	PyGILState_STATE gstate;
+	int ret;
+
+	if (!di) {
+		srd_err("Invalid decoder instance.");
+		return SRD_ERR_ARG;
+	}
+
+	session_async_idle(di->sess);
+	gstate = PyGILState_Ensure();
+	ret = inst_option_set(di, options);
+	PyGILState_Release(gstate);
+
+	return ret;
+}
+
 /* Helper GComparefunc for g_slist_find_custom() in srd_inst_probe_set_all() */
 static gint compare_probe_id(const struct srd_probe *a, const char *probe_id)
 {
@@ -236,7 +264,7 @@ SRD_API int srd_inst_probe_set_all(struct srd_decoder_inst *di,
 	GList *l;
 	GSList *sl;
 	struct srd_probe *p;
-	int *new_probemap, new_probenum, num_required_probes, num_probes, i;
+	int *new_probemap, new_probenum, num_required_probes, i;
 	char *probe_id;
 
 	srd_dbg("set probes called for instance %s with list of %d probes",
@@ -246,6 +274,9 @@ SRD_API int srd_inst_probe_set_all(struct srd_decoder_inst *di,
 		/* No probes provided. */
 		return SRD_OK;
 
+	/* The decode thread maps the probes. */
+	session_async_idle(di->sess);
+
 	if (di->dec_num_probes == 0) {
 		/* Decoder has no probes. */
 		srd_err("Protocol decoder %s has no probes to define.",
@@ -267,7 +298,6 @@ SRD_API int srd_inst_probe_set_all(struct srd_decoder_inst *di,
 	for (i = 0; i < di->dec_num_probes; i++)
 		new_probemap[i] = -1;
 
-	num_probes = 0;
 	for (l = g_hash_table_get_keys(new_probes); l; l = l->next) {
 		probe_id = l->data;
 		probe_val = g_hash_table_lookup(new_probes, probe_id);
@@ -294,9 +324,7 @@ SRD_API int srd_inst_probe_set_all(struct srd_decoder_inst *di,
 		new_probemap[p->order] = new_probenum;
 		srd_dbg("Setting probe mapping: %s (index %d) = probe %d.",
 			p->id, p->order, new_probenum);
-		num_probes++;
 	}
-	di->data_unitsize = (num_probes + 7) / 8;
 
 	srd_dbg("Final probe map:");
 	num_required_probes = g_slist_length(di->decoder->probes);
@@ -311,20 +339,8 @@ SRD_API int srd_inst_probe_set_all(struct srd_decoder_inst *di,
 	return SRD_OK;
 }
 
-/**
- * Create a new protocol decoder instance.
- *
- * @param sess The session holding the protocol decoder instance.
- * @param decoder_id Decoder 'id' field.
- * @param options GHashtable of options which override the defaults set in
- *                the decoder class. May be NULL.
- *
- * @return Pointer to a newly allocated struct srd_decoder_inst, or
- *         NULL in case of failure.
- *
- * @since 0.3.0
- */
-SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
+/* Create the instance, with the Python interpreter lock held. */
+static struct srd_decoder_inst *inst_new(struct srd_session *sess,
 		const char *decoder_id, GHashTable *options)
 {
 	int i;
@@ -332,13 +348,6 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 	struct srd_decoder_inst *di;
 	char *inst_id;
 
-	srd_dbg("Creating new %s instance.", decoder_id);
-
-	if (session_is_valid(sess) != SRD_OK) {
-		srd_err("Invalid session.");
-		return NULL;
-	}
-
 	if (!(dec = srd_decoder_get_by_id(decoder_id))) {
 		srd_err("Protocol decoder %s not found.", decoder_id);
 		return NULL;
@@ -368,21 +377,17 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 		if (!(di->dec_probemap =
 				g_try_malloc(sizeof(int) * di->dec_num_probes))) {
 			srd_err("Failed to g_malloc() probe map.");
-			g_free(di);
-			return NULL;
+			goto err_out;
 		}
 		for (i = 0; i < di->dec_num_probes; i++)
 			di->dec_probemap[i] = i;
-		di->data_unitsize = (di->dec_num_probes + 7) / 8;
 		/*
 		 * Will be used to prepare a sample at every iteration
 		 * of the instance's decode() method.
 		 */
 		if (!(di->probe_samples = g_try_malloc(di->dec_num_probes))) {
 			srd_err("Failed to g_malloc() sample buffer.");
-			g_free(di->dec_probemap);
-			g_free(di);
-			return NULL;
+			goto err_out;
 		}
 	}
 
@@ -391,21 +396,184 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 		if (PyErr_Occurred())
 			srd_exception_catch("failed to create %s instance: ",
 					decoder_id);
-		g_free(di->dec_probemap);
-		g_free(di);
-		return NULL;
+		goto err_out;
 	}
 
-	if (options && srd_inst_option_set(di, options) != SRD_OK) {
-		g_free(di->dec_probemap);
-		g_free(di);
-		return NULL;
+	/* Let put() and register() get back to the instance directly. */
+	if (!PyObject_TypeCheck(di->py_inst, &srd_Decoder_type)) {
+		srd_err("%s instance is not a sigrokdecode.Decoder.",
+				decoder_id);
+		goto err_out;
 	}
+	((srd_Decoder *)di->py_inst)->di = di;
+
+	if (options && inst_option_set(di, options) != SRD_OK)
+		goto err_out;
 
 	/* Instance takes input from a frontend by default. */
 	sess->di_list = g_slist_append(sess->di_list, di);
 
 	return di;
+
+err_out:
+	/* The PD may hold on to its object, but the instance is gone. */
+	if (di->py_inst && PyObject_TypeCheck(di->py_inst, &srd_Decoder_type))
+		((srd_Decoder *)di->py_inst)->di = NULL;
+	Py_XDECREF(di->py_inst);
+	g_free(di->inst_id);
+	g_free(di->probe_samples);
+	g_free(di->dec_probemap);
+	g_free(di);
+
+	return NULL;
+}
+
+/**
+ * Create a new protocol decoder instance.
+ *
+ * @param sess The session holding the protocol decoder instance.
+ * @param decoder_id Decoder 'id' field.
+ * @param options GHashtable of options which override the defaults set in
+ *                the decoder class. May be NULL.
+ *
+ * @return Pointer to a newly allocated struct srd_decoder_inst, or
+ *         NULL in case of failure.
+ *
+ * @since 0.3.0
+ */
+SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
+		const char *decoder_id, GHashTable *options)
+{
+	PyGILState_STATE gstate;
+	struct srd_decoder_inst *di;
+
+	srd_dbg("Creating new %s instance.", decoder_id);
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return NULL;
+	}
+
+	session_async_idle(sess);
+	gstate = PyGILState_Ensure();
+	di = inst_new(sess, decoder_id, options);
+	PyGILState_Release(gstate);
+
+	return di;
+}
+
+static void inst_decimator_free(struct srd_decimator *decim)
+{
+	if (!decim)
+		return;
+
+	srd_chunk_edges_clear(&decim->chunk);
+	g_free(decim->chunk.edges);
+	g_free(decim->chunk.planes);
+	g_free(decim->chunk.prev_bits);
+	g_free(decim->chunk.plane_buf);
+	g_free(decim->high);
+	g_free(decim->level);
+	g_free(decim);
+}
+
+/**
+ * Set up decimation of the samples passed to a decoder instance.
+ *
+ * Heavily oversampled signals of slow protocols can be decoded with
+ * a fraction of the samples. The instance then gets one sample for every
+ * group of factor samples, and a samplerate divided by factor in its
+ * metadata. Sample n of the decimated samples stands for sample
+ * n * factor of the capture, and all sample numbers the instance sees
+ * are those of the decimated samples: the ss and es passed to decode()
+ * and decode_block(), those returned by the iterator, wait() and skip(),
+ * the ones passed to skip(), and the ones listed by edges(). That way
+ * they agree with its samplerate. Only the sample numbers it passes to
+ * put() are converted back to sample numbers of the capture, so its
+ * annotations line up with those of other instances.
+ *
+ * Only instances which take input from the frontend can be decimated.
+ * This must be set up before the samplerate is passed to the session with
+ * srd_session_metadata_set().
+ *
+ * @param di The instance to configure.
+ * @param factor Number of samples in a group. 0 or 1 turns decimation off.
+ * @param mode How the samples in a group are turned into one, either
+ *             SRD_DECIMATE_MAJORITY or SRD_DECIMATE_EDGES.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_inst_decimation_set(struct srd_decoder_inst *di,
+		uint64_t factor, int mode)
+{
+	PyGILState_STATE gstate;
+
+	if (!di) {
+		srd_err("Invalid decoder instance.");
+		return SRD_ERR_ARG;
+	}
+
+	if (mode != SRD_DECIMATE_MAJORITY && mode != SRD_DECIMATE_EDGES) {
+		srd_err("Invalid decimation mode %d.", mode);
+		return SRD_ERR_ARG;
+	}
+
+	/* The decode thread uses the decimator. */
+	session_async_idle(di->sess);
+
+	if (factor < 2) {
+		gstate = PyGILState_Ensure();
+		inst_decimator_free(di->decim);
+		PyGILState_Release(gstate);
+		di->decim = NULL;
+		return SRD_OK;
+	}
+
+	if (!g_slist_find(di->sess->di_list, di)) {
+		srd_err("Instance %s doesn't take input from the frontend.",
+				di->inst_id);
+		return SRD_ERR_ARG;
+	}
+
+	if (!di->decim && !(di->decim = g_try_malloc0(sizeof(*di->decim)))) {
+		srd_err("Failed to g_malloc() decimator.");
+		return SRD_ERR_MALLOC;
+	}
+	di->decim->factor = factor;
+	di->decim->mode = mode;
+	di->decim->next_samplenum = G_MAXUINT64;
+
+	srd_dbg("Decimating samples of instance %s by %" PRIu64 ".",
+			di->inst_id, factor);
+
+	return SRD_OK;
+}
+
+/**
+ * Check whether a stacked instance takes the given output of the instance
+ * below it, through any of the streams it was stacked on.
+ *
+ * @private
+ */
+SRD_PRIV gboolean srd_inst_takes_output(const struct srd_decoder_inst *di,
+		const struct srd_pd_output *pdo)
+{
+	const struct srd_stack_edge *edge;
+	GSList *l;
+
+	if (pdo->output_type != SRD_OUTPUT_PYTHON)
+		return FALSE;
+
+	for (l = pdo->di->next_streams; l; l = l->next) {
+		edge = l->data;
+		if (edge->di == di && (!edge->proto_id ||
+				!strcmp(edge->proto_id, pdo->proto_id)))
+			return TRUE;
+	}
+
+	return FALSE;
 }
 
 /**
@@ -422,6 +590,37 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 SRD_API int srd_inst_stack(struct srd_session *sess,
 		struct srd_decoder_inst *di_from, struct srd_decoder_inst *di_to)
 {
+	return srd_inst_stack_proto(sess, di_from, di_to, NULL);
+}
+
+/**
+ * Stack a decoder instance on top of one of the output streams of another.
+ *
+ * Decoders like i2cdemux register an output stream for each device they
+ * see, each with a proto_id of its own. An instance stacked on one of them
+ * only gets the data put() on that stream, and isn't called at all for
+ * the others. Stacking it again on the same instance adds to the streams
+ * it takes from there.
+ *
+ * @param sess The session holding the protocol decoder instances.
+ * @param di_from The instance on top of which di_to will be stacked.
+ * @param di_to The instance to move.
+ * @param proto_id The proto_id of the streams di_to takes, such as
+ *                 "i2c-0x48", or NULL to take all of them, as with
+ *                 srd_inst_stack().
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_inst_stack_proto(struct srd_session *sess,
+		struct srd_decoder_inst *di_from, struct srd_decoder_inst *di_to,
+		const char *proto_id)
+{
+	PyGILState_STATE gstate;
+	struct srd_pd_output *pdo;
+	struct srd_stack_edge *edge;
+	GSList *l;
 
 	if (session_is_valid(sess) != SRD_OK) {
 		srd_err("Invalid session.");
@@ -433,13 +632,49 @@ SRD_API int srd_inst_stack(struct srd_session *sess,
 		return SRD_ERR_ARG;
 	}
 
+	if (!(edge = g_try_malloc(sizeof(struct srd_stack_edge)))) {
+		srd_err("Failed to g_malloc() stack edge.");
+		return SRD_ERR_MALLOC;
+	}
+	edge->di = di_to;
+	edge->proto_id = g_strdup(proto_id);
+
+	/* The decode thread walks the stack. */
+	session_async_idle(sess);
+
 	if (g_slist_find(sess->di_list, di_to)) {
 		/* Remove from the unstacked list. */
 		sess->di_list = g_slist_remove(sess->di_list, di_to);
 	}
 
-	/* Stack on top of source di. */
-	di_from->next_di = g_slist_append(di_from->next_di, di_to);
+	if (di_to->decim) {
+		srd_warn("Stacked instance %s can't be decimated.",
+				di_to->inst_id);
+		gstate = PyGILState_Ensure();
+		inst_decimator_free(di_to->decim);
+		PyGILState_Release(gstate);
+		di_to->decim = NULL;
+	}
+
+	/*
+	 * Stack on top of source di. Stacking it on more of the streams
+	 * adds to those it takes already, through the same edge.
+	 */
+	if (!g_slist_find(di_from->next_di, di_to))
+		di_from->next_di = g_slist_append(di_from->next_di, di_to);
+	di_from->next_streams = g_slist_append(di_from->next_streams, edge);
+
+	/* Streams registered later pick it up in register(). */
+	for (l = di_from->pd_output; l; l = l->next) {
+		pdo = l->data;
+		if (!g_slist_find(pdo->next_di, di_to) &&
+				srd_inst_takes_output(di_to, pdo))
+			pdo->next_di = g_slist_append(pdo->next_di, di_to);
+	}
+
+	if (proto_id)
+		srd_dbg("Stacked instance %s on %s streams of %s.",
+				di_to->inst_id, proto_id, di_from->inst_id);
 
 	return SRD_OK;
 }
@@ -480,62 +715,87 @@ SRD_API struct srd_decoder_inst *srd_inst_find_by_id(struct srd_session *sess,
 	return di;
 }
 
-static struct srd_decoder_inst *srd_sess_inst_find_by_obj(
-		struct srd_session *sess, const GSList *stack,
-		const PyObject *obj)
+/*
+ * Compile the instance's probe map into an extraction plan, so that
+ * getting a sample for the PD doesn't need to look at unmapped probes, or
+ * work out where to find the mapped ones, over and over again. Unmapped
+ * probes are filled in once, with their constant value.
+ */
+static int inst_plan_new(struct srd_decoder_inst *di)
 {
-	const GSList *l;
-	struct srd_decoder_inst *tmp, *di;
+	int i, k;
+
+	g_free(di->mapped_index);
+	g_free(di->mapped_probes);
+	g_free(di->mapped_planes);
+	di->mapped_index = NULL;
+	di->mapped_probes = NULL;
+	di->mapped_planes = NULL;
+
+	for (i = 0, di->num_mapped = 0; i < di->dec_num_probes; i++) {
+		if (di->dec_probemap[i] != -1)
+			di->num_mapped++;
+	}
+	if (di->num_mapped == 0)
+		return SRD_OK;
 
-	if (session_is_valid(sess) != SRD_OK) {
-		srd_err("Invalid session.");
-		return NULL;
+	di->mapped_index = g_try_malloc(sizeof(int) * di->num_mapped);
+	di->mapped_probes = g_try_malloc(sizeof(int) * di->num_mapped);
+	di->mapped_planes = g_try_malloc0(sizeof(uint64_t *) * di->num_mapped);
+	if (!di->mapped_index || !di->mapped_probes || !di->mapped_planes) {
+		srd_err("Failed to g_malloc() extraction plan.");
+		return SRD_ERR_MALLOC;
 	}
 
-	di = NULL;
-	for (l = stack ? stack : sess->di_list; di == NULL && l != NULL; l = l->next) {
-		tmp = l->data;
-		if (tmp->py_inst == obj)
-			di = tmp;
-		else if (tmp->next_di)
-			di = srd_sess_inst_find_by_obj(sess, tmp->next_di, obj);
+	for (i = 0, k = 0; i < di->dec_num_probes; i++) {
+		/* Value of unused probe is 0xff, instead of 0 or 1. */
+		if (di->dec_probemap[i] == -1) {
+			di->probe_samples[i] = 0xff;
+			continue;
+		}
+		di->mapped_index[k] = i;
+		di->mapped_probes[k] = di->dec_probemap[i];
+		k++;
 	}
 
-	return di;
+	return SRD_OK;
 }
 
-/**
- * Find a decoder instance by its Python object.
- *
- * I.e. find that instance's instantiation of the sigrokdecode.Decoder class.
- * This will recurse to find the instance anywhere in the stack tree of all
- * sessions.
- *
- * @param stack Pointer to a GSList of struct srd_decoder_inst, indicating the
- *              stack to search. To start searching at the bottom level of
- *              decoder instances, pass NULL.
- * @param obj The Python class instantiation.
- *
- * @return Pointer to struct srd_decoder_inst, or NULL if not found.
- *
- * @private
- *
- * @since 0.1.0
+/*
+ * If only a few probes are mapped, build the bytes objects for every
+ * possible sample up front, so the srd_logic iterator can hand out
+ * shared objects instead of allocating a new one for every sample.
  */
-SRD_PRIV struct srd_decoder_inst *srd_inst_find_by_obj(const GSList *stack,
-		const PyObject *obj)
+static int inst_pin_values_new(struct srd_decoder_inst *di)
 {
-	struct srd_decoder_inst *di;
-	struct srd_session *sess;
-	GSList *l;
+	PyObject *py_pin_values, *py_pins;
+	unsigned int value;
+	int k;
 
-	di = NULL;
-	for (l = sessions; di == NULL && l != NULL; l = l->next) {
-		sess = l->data;
-		di = srd_sess_inst_find_by_obj(sess, stack, obj);
+	Py_CLEAR(di->py_pin_values);
+
+	if (di->num_mapped == 0 || di->num_mapped > MAX_PREBUILT_PROBES)
+		return SRD_OK;
+
+	if (!(py_pin_values = PyTuple_New(1 << di->num_mapped))) {
+		srd_exception_catch("Failed to create sample tuple: ");
+		return SRD_ERR_PYTHON;
 	}
+	for (value = 0; value < (1U << di->num_mapped); value++) {
+		for (k = 0; k < di->num_mapped; k++)
+			di->probe_samples[di->mapped_index[k]] = (value >> k) & 1;
+		if (!(py_pins = PyBytes_FromStringAndSize(
+				(const char *)di->probe_samples,
+				di->dec_num_probes))) {
+			Py_DecRef(py_pin_values);
+			srd_exception_catch("Failed to create sample bytes: ");
+			return SRD_ERR_PYTHON;
+		}
+		PyTuple_SET_ITEM(py_pin_values, value, py_pins);
+	}
+	di->py_pin_values = py_pin_values;
 
-	return di;
+	return SRD_OK;
 }
 
 /** @private */
@@ -544,6 +804,7 @@ SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di)
 	PyObject *py_res;
 	GSList *l;
 	struct srd_decoder_inst *next_di;
+	const char *method;
 	int ret;
 
 	srd_dbg("Calling start() method on protocol decoder instance %s.",
@@ -556,6 +817,49 @@ SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di)
 	}
 	Py_DecRef(py_res);
 
+	/*
+	 * A PD can ask to only be handed samples where one of its probes
+	 * changed, by setting its 'edges_only' attribute to True.
+	 */
+	di->edges_only = FALSE;
+	if (PyObject_HasAttrString(di->py_inst, "edges_only")) {
+		py_res = PyObject_GetAttrString(di->py_inst, "edges_only");
+		di->edges_only = py_res && PyObject_IsTrue(py_res) == 1;
+		Py_XDECREF(py_res);
+	}
+	di->got_sample = FALSE;
+
+	/* A PD which can work on whole chunks defines decode_block(). */
+	di->decode_block = PyObject_HasAttrString(di->py_inst, "decode_block");
+	/* A stacked PD which can take many packets at once, decode_batch(). */
+	di->decode_batch = PyObject_HasAttrString(di->py_inst, "decode_batch");
+	Py_CLEAR(di->py_batch);
+
+	/* Look the method up once, instead of on every call. */
+	method = di->decode_block ? "decode_block" : "decode";
+	Py_CLEAR(di->py_decode);
+	if (PyObject_HasAttrString(di->py_inst, method) &&
+	    !(di->py_decode = PyObject_GetAttrString(di->py_inst, method))) {
+		srd_exception_catch("Protocol decoder instance %s: ",
+				di->inst_id);
+		return SRD_ERR_PYTHON;
+	}
+	Py_CLEAR(di->py_decode_batch);
+	if (di->decode_batch && !(di->py_decode_batch =
+	    PyObject_GetAttrString(di->py_inst, "decode_batch"))) {
+		srd_exception_catch("Protocol decoder instance %s: ",
+				di->inst_id);
+		return SRD_ERR_PYTHON;
+	}
+
+	if (di->decim)
+		di->decim->next_samplenum = G_MAXUINT64;
+
+	if ((ret = inst_plan_new(di)) != SRD_OK)
+		return ret;
+	if ((ret = inst_pin_values_new(di)) != SRD_OK)
+		return ret;
+
 	/* Start all the PDs stacked on top of this one. */
 	for (l = di->next_di; l; l = l->next) {
 		next_di = l->data;
@@ -566,65 +870,349 @@ SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di)
 	return SRD_OK;
 }
 
+/*
+ * Decimate the mapped probes of the session's chunk into the instance's
+ * own chunk, which only holds the groups completed by this chunk.
+ */
+static int inst_decimate(struct srd_decoder_inst *di)
+{
+	struct srd_decimator *decim;
+	const struct srd_chunk *chunk;
+	struct srd_chunk *out;
+	uint64_t words, group_len;
+	int num_planes, probe, i;
+
+	decim = di->decim;
+	chunk = &di->sess->chunk;
+	out = &decim->chunk;
+	num_planes = chunk->unitsize * 8;
+
+	srd_chunk_edges_clear(out);
+	if (out->unitsize != chunk->unitsize) {
+		g_free(out->planes);
+		g_free(out->prev_bits);
+		g_free(out->edges);
+		g_free(decim->high);
+		g_free(decim->level);
+		out->planes = g_try_malloc0(sizeof(uint64_t *) * num_planes);
+		out->prev_bits = g_try_malloc(num_planes);
+		out->edges = g_try_malloc0(sizeof(PyObject *) * num_planes);
+		decim->high = g_try_malloc(sizeof(uint64_t) * num_planes);
+		decim->level = g_try_malloc(num_planes);
+		if (!out->planes || !out->prev_bits || !out->edges ||
+				!decim->high || !decim->level) {
+			out->unitsize = 0;
+			srd_err("Failed to g_malloc() decimated chunk.");
+			return SRD_ERR_MALLOC;
+		}
+		out->unitsize = chunk->unitsize;
+		decim->next_samplenum = G_MAXUINT64;
+	}
+
+	words = (chunk->num_samples / decim->factor + 1 + 63) / 64;
+	if (words * di->num_mapped > out->plane_buf_words) {
+		g_free(out->plane_buf);
+		out->plane_buf_words = 0;
+		if (!(out->plane_buf = g_try_malloc(sizeof(uint64_t) *
+				words * di->num_mapped))) {
+			srd_err("Failed to g_malloc() decimated planes.");
+			return SRD_ERR_MALLOC;
+		}
+		out->plane_buf_words = words * di->num_mapped;
+	}
+
+	/* Groups can't be carried over a gap in the samples. */
+	if (chunk->start_samplenum != decim->next_samplenum) {
+		decim->group_len = 0;
+		memset(decim->high, 0, sizeof(uint64_t) * num_planes);
+		memset(decim->level, 0xff, num_planes);
+	}
+
+	out->format = SRD_CHUNK_PLANES;
+	out->start_samplenum = chunk->start_samplenum / decim->factor;
+	out->num_samples = (chunk->start_samplenum + chunk->num_samples) /
+			decim->factor - out->start_samplenum;
+	for (i = 0; i < di->num_mapped; i++)
+		out->planes[di->mapped_probes[i]] = NULL;
+
+	group_len = decim->group_len;
+	for (i = 0; i < di->num_mapped; i++) {
+		probe = di->mapped_probes[i];
+		/* Several of the PD's probes can be mapped to one probe. */
+		if (out->planes[probe])
+			continue;
+		out->planes[probe] = out->plane_buf + i * words;
+		out->prev_bits[probe] = decim->level[probe];
+		group_len = srd_decimate(out->planes[probe], chunk, probe,
+				decim->factor, decim->mode, decim->group_len,
+				&decim->high[probe], &decim->level[probe]);
+		if (out->prev_bits[probe] == 0xff && out->num_samples > 0)
+			out->prev_bits[probe] = out->planes[probe][0] & 1;
+	}
+	decim->group_len = group_len;
+	decim->next_samplenum = chunk->start_samplenum + chunk->num_samples;
+
+	return SRD_OK;
+}
+
+/*
+ * Hand the chunk to the PD's decode_block() method, as a tuple with an
+ * entry for each of the PD's probes: a bytes object holding the probe's
+ * value in each sample as 0 or 1, or None for probes which aren't mapped.
+ * Chunks of more than BLOCK_MAX_SAMPLES samples, such as long runs, are
+ * handed over in several calls of at most that many samples each.
+ */
+static int inst_decode_block(const struct srd_decoder_inst *di,
+		const struct srd_chunk *chunk, uint64_t start_samplenum,
+		uint64_t end_samplenum)
+{
+	PyObject *py_samples, *py_probe, *py_res;
+	uint64_t n, len;
+	int i;
+
+	for (n = 0; n < chunk->num_samples; n += len) {
+		len = MIN(chunk->num_samples - n, BLOCK_MAX_SAMPLES);
+		if (!(py_samples = PyTuple_New(di->dec_num_probes))) {
+			srd_exception_catch("Failed to create sample tuple: ");
+			return SRD_ERR_PYTHON;
+		}
+		for (i = 0; i < di->dec_num_probes; i++) {
+			Py_INCREF(Py_None);
+			PyTuple_SET_ITEM(py_samples, i, Py_None);
+		}
+
+		for (i = 0; i < di->num_mapped; i++) {
+			if (!(py_probe = PyBytes_FromStringAndSize(NULL, len))) {
+				Py_DecRef(py_samples);
+				srd_exception_catch("Failed to create probe "
+						"samples: ");
+				return SRD_ERR_PYTHON;
+			}
+			srd_chunk_probe_bytes(
+					(uint8_t *)PyBytes_AS_STRING(py_probe),
+					chunk, di->mapped_probes[i], n, len);
+			Py_DecRef(PyTuple_GET_ITEM(py_samples,
+					di->mapped_index[i]));
+			PyTuple_SET_ITEM(py_samples, di->mapped_index[i],
+					py_probe);
+		}
+
+		/* The last call ends where the chunk was said to end. */
+		py_res = srd_inst_call_decode(di, start_samplenum + n,
+				n + len < chunk->num_samples ?
+				start_samplenum + n + len : end_samplenum,
+				py_samples);
+		Py_DecRef(py_samples);
+		if (!py_res) {
+			srd_exception_catch("Protocol decoder instance %s: ",
+					di->inst_id);
+			return SRD_ERR_PYTHON;
+		}
+		Py_DecRef(py_res);
+	}
+
+	return SRD_OK;
+}
+
 /**
- * Run the specified decoder function.
+ * Call the decode() or decode_block() method of an instance, as looked up
+ * by srd_inst_start().
  *
  * @param di The decoder instance to call. Must not be NULL.
- * @param start_samplenum The starting sample number for the buffer's sample
- * 			  set, relative to the start of capture.
- * @param end_samplenum The ending sample number for the buffer's sample
- * 			  set, relative to the start of capture.
- * @param inbuf The buffer to decode. Must not be NULL.
- * @param inbuflen Length of the buffer. Must be > 0.
+ * @param start_samplenum The first sample number of the data.
+ * @param end_samplenum The sample number following the data.
+ * @param py_data The samples, or the packet of a lower level PD.
  *
- * @return SRD_OK upon success, a (negative) error code otherwise.
+ * @return The method's return value, or NULL with a Python exception set.
  *
  * @private
- *
- * @since 0.1.0
  */
-SRD_PRIV int srd_inst_decode(const struct srd_decoder_inst *di,
+SRD_PRIV PyObject *srd_inst_call_decode(const struct srd_decoder_inst *di,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		PyObject *py_data)
+{
+	PyObject *py_args[4], *py_res;
+
+	if (!di->py_decode) {
+		PyErr_Format(PyExc_AttributeError, "Instance %s has no decode() "
+				"method, or wasn't started.", di->inst_id);
+		return NULL;
+	}
+
+	if (!(py_args[1] = PyLong_FromUnsignedLongLong(start_samplenum)))
+		return NULL;
+	if (!(py_args[2] = PyLong_FromUnsignedLongLong(end_samplenum))) {
+		Py_DecRef(py_args[1]);
+		return NULL;
+	}
+	py_args[3] = py_data;
+
+#if PY_VERSION_HEX >= 0x03090000
+	/*
+	 * No argument tuple is built. The bound method may use py_args[0]
+	 * for the instance, so it doesn't have to copy the arguments either.
+	 */
+	py_res = PyObject_Vectorcall(di->py_decode, py_args + 1,
+			3 | PY_VECTORCALL_ARGUMENTS_OFFSET, NULL);
+#else
+	py_res = PyObject_CallFunctionObjArgs(di->py_decode, py_args[1],
+			py_args[2], py_args[3], NULL);
+#endif
+	Py_DecRef(py_args[2]);
+	Py_DecRef(py_args[1]);
+
+	return py_res;
+}
+
+/*
+ * Hand the packets queued for the instances stacked on top of this one to
+ * their decode_batch() methods, then do the same for the instances on top
+ * of those, which may have got packets from them.
+ */
+static int inst_batch_flush(const struct srd_decoder_inst *di)
+{
+	struct srd_decoder_inst *next_di;
+	PyObject *py_args[2], *py_batch, *py_res;
+	GSList *l;
+	int ret, flushed;
+
+	ret = SRD_OK;
+	for (l = di->next_di; l; l = l->next) {
+		next_di = l->data;
+		if ((py_batch = next_di->py_batch)) {
+			/* Packets put() from here on go into a new batch. */
+			next_di->py_batch = NULL;
+			py_args[1] = py_batch;
+#if PY_VERSION_HEX >= 0x03090000
+			/* Same as in srd_inst_call_decode(). */
+			py_res = PyObject_Vectorcall(next_di->py_decode_batch,
+					py_args + 1,
+					1 | PY_VECTORCALL_ARGUMENTS_OFFSET, NULL);
+#else
+			py_res = PyObject_CallFunctionObjArgs(
+					next_di->py_decode_batch, py_args[1],
+					NULL);
+#endif
+			Py_DecRef(py_batch);
+			if (!py_res) {
+				srd_exception_catch("Protocol decoder instance "
+						"%s: ", next_di->inst_id);
+				ret = SRD_ERR_PYTHON;
+			}
+			Py_XDECREF(py_res);
+		}
+		if ((flushed = inst_batch_flush(next_di)) != SRD_OK)
+			ret = flushed;
+	}
+
+	return ret;
+}
+
+/*
+ * Release the memoryview over the raw buffer once decode() has returned,
+ * as the frontend's buffer may go away after that. This fails while the
+ * PD still holds a view taken from it, which then fails decode() too, and
+ * stops the instance for good.
+ */
+static PyObject *inst_view_release(srd_logic *logic, PyObject *py_res)
+{
+	PyObject *py_rel, *py_type, *py_value, *py_tb;
+
+	if (!logic->py_view)
+		return py_res;
+
+	PyErr_Fetch(&py_type, &py_value, &py_tb);
+	if ((py_rel = PyObject_CallMethod(logic->py_view, "release", NULL))) {
+		Py_DecRef(py_rel);
+	} else {
+		PyErr_Clear();
+		logic->di->view_kept = TRUE;
+		if (py_res) {
+			Py_DecRef(py_res);
+			PyErr_SetString(PyExc_BufferError, "decode() kept a "
+					"view on the sample buffer after "
+					"returning.");
+			return NULL;
+		}
+	}
+	PyErr_Restore(py_type, py_value, py_tb);
+
+	return py_res;
+}
+
+/* Run the instance's decode() or decode_block() method over the chunk. */
+static int inst_decode(struct srd_decoder_inst *di,
 		uint64_t start_samplenum, uint64_t end_samplenum,
 		const uint8_t *inbuf, uint64_t inbuflen)
 {
 	PyObject *py_res;
 	srd_logic *logic;
+	struct srd_chunk *chunk;
+	int i, ret;
 
-	srd_dbg("Calling decode() on instance %s with %" PRIu64 " bytes "
-		"starting at sample %" PRIu64 ".", di->inst_id, inbuflen,
-		start_samplenum);
-
-	/* Return an error upon unusable input. */
-	if (!di) {
-		srd_dbg("empty decoder instance");
-		return SRD_ERR_ARG;
-	}
-	if (!inbuf) {
-		srd_dbg("NULL buffer pointer");
-		return SRD_ERR_ARG;
+	if (di->view_kept) {
+		srd_err("Instance %s kept a view on a sample buffer, and "
+				"decodes no more chunks.", di->inst_id);
+		return SRD_ERR;
 	}
-	if (inbuflen == 0) {
-		srd_dbg("empty buffer");
-		return SRD_ERR_ARG;
+
+	chunk = &di->sess->chunk;
+	if (di->decim) {
+		if ((ret = inst_decimate(di)) != SRD_OK)
+			return ret;
+		chunk = &di->decim->chunk;
+		if (chunk->num_samples == 0)
+			/* No group was completed yet. */
+			return SRD_OK;
+		/*
+		 * The raw buffer doesn't match the decimated samples, and
+		 * the PD gets their sample numbers, see
+		 * srd_inst_decimation_set().
+		 */
+		start_samplenum = chunk->start_samplenum;
+		end_samplenum = start_samplenum + chunk->num_samples;
+		inbuf = NULL;
+		inbuflen = 0;
 	}
 
+	if (di->decode_block)
+		return inst_decode_block(di, chunk, start_samplenum,
+				end_samplenum);
+
 	/*
 	 * Create new srd_logic object. Each iteration around the PD's loop
 	 * will fill one sample into this object.
 	 */
-	logic = PyObject_New(srd_logic, &srd_logic_type);
-	Py_INCREF(logic);
-	logic->di = (struct srd_decoder_inst *)di;
+	if (!(logic = PyObject_New(srd_logic, &srd_logic_type))) {
+		srd_exception_catch("Failed to create srd_logic object: ");
+		return SRD_ERR_PYTHON;
+	}
+	logic->di = di;
+	logic->chunk = chunk;
+	if (logic->chunk->format == SRD_CHUNK_PLANES) {
+		for (i = 0; i < di->num_mapped; i++)
+			di->mapped_planes[i] =
+				chunk->planes[di->mapped_probes[i]];
+	}
 	logic->start_samplenum = start_samplenum;
 	logic->itercnt = 0;
+	logic->run = 0;
 	logic->inbuf = (uint8_t *)inbuf;
 	logic->inbuflen = inbuflen;
-	logic->sample = PyList_New(2);
-	Py_INCREF(logic->sample);
+	logic->py_view = NULL;
+	if (!(logic->sample = PyList_New(2))) {
+		Py_DecRef((PyObject *)logic);
+		srd_exception_catch("Failed to create sample list: ");
+		return SRD_ERR_PYTHON;
+	}
 
-	Py_IncRef(di->py_inst);
-	if (!(py_res = PyObject_CallMethod(di->py_inst, "decode",
-			"KKO", start_samplenum, end_samplenum, logic))) {
+	py_res = srd_inst_call_decode(di, start_samplenum, end_samplenum,
+			(PyObject *)logic);
+	py_res = inst_view_release(logic, py_res);
+	logic->inbuf = NULL;
+	logic->inbuflen = 0;
+	Py_DecRef((PyObject *)logic);
+	if (!py_res) {
 		srd_exception_catch("Protocol decoder instance %s: ", di->inst_id);
 		return SRD_ERR_PYTHON;
 	}
@@ -633,21 +1221,84 @@ SRD_PRIV int srd_inst_decode(const struct srd_decoder_inst *di,
 	return SRD_OK;
 }
 
+/**
+ * Run the specified decoder function.
+ *
+ * @param di The decoder instance to call. Must not be NULL.
+ * @param start_samplenum The starting sample number for the buffer's sample
+ * 			  set, relative to the start of capture.
+ * @param end_samplenum The ending sample number for the buffer's sample
+ * 			  set, relative to the start of capture.
+ * @param inbuf The raw buffer the session's chunk was unpacked from, or
+ *              NULL if the chunk didn't come from a raw buffer.
+ * @param inbuflen Length of the buffer.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @private
+ *
+ * @since 0.1.0
+ */
+SRD_PRIV int srd_inst_decode(struct srd_decoder_inst *di,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen)
+{
+	int ret, flushed;
+
+	/* Return an error upon unusable input. */
+	if (!di) {
+		srd_dbg("empty decoder instance");
+		return SRD_ERR_ARG;
+	}
+
+	srd_dbg("Calling decode() on instance %s with %" PRIu64 " bytes "
+		"starting at sample %" PRIu64 ".", di->inst_id, inbuflen,
+		start_samplenum);
+
+	ret = inst_decode(di, start_samplenum, end_samplenum, inbuf,
+			inbuflen);
+
+	/* Whatever got put() for stacked instances is passed on anyway. */
+	if ((flushed = inst_batch_flush(di)) != SRD_OK && ret == SRD_OK)
+		ret = flushed;
+
+	return ret;
+}
+
 /** @private */
 SRD_PRIV void srd_inst_free(struct srd_decoder_inst *di)
 {
 	GSList *l;
 	struct srd_pd_output *pdo;
+	struct srd_stack_edge *edge;
 
 	srd_dbg("Freeing instance %s", di->inst_id);
 
+	/* The PD may hold on to its object, but the instance is gone. */
+	((srd_Decoder *)di->py_inst)->di = NULL;
+	Py_XDECREF(di->py_decode);
+	Py_XDECREF(di->py_decode_batch);
 	Py_DecRef(di->py_inst);
+	Py_XDECREF(di->py_batch);
+	Py_XDECREF(di->py_pin_values);
+	g_free(di->mapped_index);
+	g_free(di->mapped_probes);
+	g_free(di->mapped_planes);
+	inst_decimator_free(di->decim);
 	g_free(di->inst_id);
+	g_free(di->probe_samples);
 	g_free(di->dec_probemap);
 	g_slist_free(di->next_di);
+	for (l = di->next_streams; l; l = l->next) {
+		edge = l->data;
+		g_free(edge->proto_id);
+		g_free(edge);
+	}
+	g_slist_free(di->next_streams);
 	for (l = di->pd_output; l; l = l->next) {
 		pdo = l->data;
 		g_free(pdo->proto_id);
+		g_slist_free(pdo->next_di);
 		g_free(pdo);
 	}
 	g_slist_free(di->pd_output);
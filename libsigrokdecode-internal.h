@@ -24,6 +24,99 @@
 
 #include "libsigrokdecode.h"
 
+/** @cond PRIVATE */
+enum {
+	/* Unpacked from raw samples into bit planes. */
+	SRD_CHUNK_PLANES,
+	/* Run-length encoded, one value for every run of samples. */
+	SRD_CHUNK_RUNS,
+};
+/** @endcond */
+
+/*
+ * The chunk of logic samples currently being decoded in a session.
+ *
+ * Raw samples are unpacked into one bit plane per probe: bit n of
+ * planes[p] holds the value of probe p in sample n of the chunk. Only the
+ * probes used by one of the session's instances are unpacked, the other
+ * planes are NULL.
+ *
+ * Run-length encoded samples are kept as they are: run r starts at sample
+ * run_starts[r] of the chunk, and all its samples have the value at
+ * run_values + r * unitsize. The values belong to the frontend, and are
+ * only valid while the chunk is being decoded.
+ */
+struct srd_chunk {
+	uint64_t start_samplenum;
+	uint64_t num_samples;
+	int unitsize;
+	int format;
+	uint64_t **planes;
+	uint8_t *lane_masks;
+
+	uint64_t num_runs;
+	uint64_t *run_starts;
+	const uint8_t *run_values;
+
+	/*
+	 * Value of each probe in the last sample of the previous chunk, so
+	 * edges right at the start of this chunk can be found.
+	 */
+	uint8_t *prev_bits;
+
+	/*
+	 * Sample numbers of the changes on each probe, as bytes objects
+	 * holding arrays of uint64_t. Built on first use by
+	 * srd_chunk_edges(), and shared by all instances decoding the chunk.
+	 */
+	PyObject **edges;
+
+	/* Backing store for the planes and runs, reused for every chunk. */
+	uint64_t *plane_buf;
+	uint64_t plane_buf_words;
+	uint64_t run_starts_len;
+};
+
+/*
+ * Value of the given probe in sample n of the chunk, which lies in the
+ * given run if the chunk is run-length encoded.
+ */
+static inline unsigned int srd_chunk_bit(const struct srd_chunk *chunk,
+		int probe, uint64_t n, uint64_t run)
+{
+	if (chunk->format == SRD_CHUNK_RUNS)
+		return (chunk->run_values[run * chunk->unitsize + probe / 8]
+				>> (probe % 8)) & 1;
+
+	return (chunk->planes[probe][n / 64] >> (n % 64)) & 1;
+}
+
+/*
+ * Decimation of the chunk for an instance, see srd_inst_decimation_set().
+ * Sample n of the decimated chunk stands for the factor samples starting
+ * at sample n * factor of the capture.
+ */
+struct srd_decimator {
+	uint64_t factor;
+	int mode;
+	struct srd_chunk chunk;
+
+	/* The sample expected next, and the incomplete group up to it. */
+	uint64_t next_samplenum;
+	uint64_t group_len;
+	uint64_t *high;
+	uint8_t *level;
+};
+
+/*
+ * An instance stacked on the Python output of another one, with the
+ * proto_id of the streams it takes, or NULL for all of them.
+ */
+struct srd_stack_edge {
+	struct srd_decoder_inst *di;
+	char *proto_id;
+};
+
 struct srd_session {
 	int session_id;
 
@@ -32,6 +125,90 @@ struct srd_session {
 
 	/* List of frontend callbacks to receive decoder output. */
 	GSList *callbacks;
+
+	/* The chunk passed to srd_session_send() or srd_session_send_rle(). */
+	struct srd_chunk chunk;
+
+	/*
+	 * Small chunks passed to srd_session_send() are collected in here
+	 * before being decoded, see srd_session_coalesce_set().
+	 */
+	uint64_t coalesce_size;
+	gint64 coalesce_age;
+	uint8_t *pending;
+	uint64_t pending_len;
+	uint64_t pending_start;
+	uint64_t pending_unitsize;
+	gint64 pending_since;
+
+	/*
+	 * Minimum pulse width on each probe, see
+	 * srd_session_glitch_filter_set().
+	 */
+	uint64_t glitch_width;
+	uint64_t *glitch_widths;
+	int num_glitch_widths;
+	gboolean glitch_warned;
+
+	/*
+	 * The last samples of the previous chunk, held back unfiltered until
+	 * the next one shows whether their changes are glitches: held_len
+	 * samples from held_start on, with the plane of probe p at
+	 * held + p * held_words.
+	 */
+	uint64_t *held;
+	uint64_t held_buf_words;
+	uint64_t held_words;
+	uint64_t held_len;
+	uint64_t held_start;
+
+	/*
+	 * Value of the last event passed to srd_session_send_events(), of
+	 * event_unitsize bytes, or 0 if there was none yet. Chunks starting
+	 * before their first event get their runs put together in
+	 * event_runs.
+	 */
+	uint8_t *event_value;
+	int event_unitsize;
+	uint8_t *event_runs;
+	uint64_t event_runs_len;
+
+	/*
+	 * Shared memory ring the session decodes from, see
+	 * srd_session_shm_attach(). The layout is checked once, and kept in
+	 * here where the producer can't change it any more.
+	 */
+	struct srd_shm_ring *shm_ring;
+	uint64_t shm_len;
+	const uint8_t *shm_data;
+	uint64_t shm_size;
+	uint64_t shm_unitsize;
+	uint64_t shm_tail;
+
+	/* Samples the frontend shows, see srd_session_window_set(). */
+	uint64_t window_start;
+	uint64_t window_end;
+
+	/*
+	 * Chunks passed to srd_session_send() wait in async_queue for the
+	 * decode thread, see srd_session_async_set(). The mutex protects
+	 * the queue and the state of the thread; the condition is signalled
+	 * whenever any of them changes.
+	 */
+	GThread *async_thread;
+	GMutex async_mutex;
+	GCond async_cond;
+	GQueue async_queue;
+	uint64_t async_size;
+	uint64_t async_queued;
+	int async_policy;
+	gboolean async_busy;
+	gboolean async_stop;
+	/* First error of the decode thread, not yet returned to the caller. */
+	int async_ret;
+	uint64_t async_dropped;
+	srd_session_decoded_callback_t async_cb;
+	void *async_cb_data;
 };
 
 
@@ -41,19 +218,46 @@ SRD_PRIV gboolean srd_check_init(void);
 
 /* session.c */
 SRD_PRIV int session_is_valid(struct srd_session *sess);
+SRD_PRIV void session_async_idle(struct srd_session *sess);
 SRD_PRIV struct srd_pd_callback *srd_pd_output_callback_find(struct srd_session *sess,
 		int output_type);
+SRD_PRIV PyObject *srd_chunk_edges(struct srd_chunk *chunk, int probe);
+SRD_PRIV void srd_chunk_edges_clear(struct srd_chunk *chunk);
 
 /* instance.c */
-SRD_PRIV struct srd_decoder_inst *srd_inst_find_by_obj( const GSList *stack,
-		const PyObject *obj);
+SRD_PRIV gboolean srd_inst_takes_output(const struct srd_decoder_inst *di,
+		const struct srd_pd_output *pdo);
 SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di);
-SRD_PRIV int srd_inst_decode(const struct srd_decoder_inst *di,
+SRD_PRIV PyObject *srd_inst_call_decode(const struct srd_decoder_inst *di,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		PyObject *py_data);
+SRD_PRIV int srd_inst_decode(struct srd_decoder_inst *di,
 		uint64_t start_samplenum, uint64_t end_samplenum,
 		const uint8_t *inbuf, uint64_t inbuflen);
 SRD_PRIV void srd_inst_free(struct srd_decoder_inst *di);
 SRD_PRIV void srd_inst_free_all(struct srd_session *sess, GSList *stack);
 
+/* type_packet.c */
+SRD_PRIV int srd_packet_module_add(PyObject *mod);
+SRD_PRIV void srd_packet_cleanup(void);
+
+/* unpack.c */
+SRD_PRIV void srd_unpack_planes(uint64_t **planes, const uint8_t *inbuf,
+		uint64_t num_samples, int unitsize, const uint8_t *lane_masks);
+SRD_PRIV void srd_glitch_filter(uint64_t *plane, uint64_t num_samples,
+		uint64_t width, unsigned int level);
+SRD_PRIV void srd_plane_copy(uint64_t *out, const uint64_t *plane,
+		uint64_t start, uint64_t len);
+SRD_PRIV void srd_plane_prepend(uint64_t *plane, uint64_t num_samples,
+		const uint64_t *head, uint64_t head_len);
+SRD_PRIV uint64_t srd_decimate(uint64_t *out, const struct srd_chunk *chunk,
+		int probe, uint64_t factor, int mode, uint64_t group_len,
+		uint64_t *high, uint8_t *level);
+SRD_PRIV void srd_chunk_probe_bytes(uint8_t *out, const struct srd_chunk *chunk,
+		int probe, uint64_t start, uint64_t len);
+SRD_PRIV uint64_t srd_find_edges(uint64_t *edges, const struct srd_chunk *chunk,
+		int probe);
+
 /* log.c */
 SRD_PRIV int srd_log(int loglevel, const char *format, ...);
 SRD_PRIV int srd_spew(const char *format, ...);
@@ -31,6 +31,8 @@ extern "C" {
 #endif
 
 struct srd_session;
+struct srd_chunk;
+struct srd_decimator;
 
 /**
  * @file
@@ -73,6 +75,7 @@ enum {
 	SRD_ERR_BUG          = -4, /**< Errors hinting at internal bugs */
 	SRD_ERR_PYTHON       = -5, /**< Python C API error */
 	SRD_ERR_DECODERS_DIR = -6, /**< Protocol decoder path invalid */
+	SRD_ERR_BUSY         = -7, /**< Decoding can't keep up with the input */
 
 	/*
 	 * Note: When adding entries here, don't forget to also update the
@@ -137,6 +140,24 @@ enum {
 	SRD_CONF_SAMPLERATE = 10000,
 };
 
+/** Ways of decimating samples, see srd_inst_decimation_set(). */
+enum {
+	/** Each sample takes the value of most samples in its group. */
+	SRD_DECIMATE_MAJORITY,
+	/** Every change within a group shows up, however short. */
+	SRD_DECIMATE_EDGES,
+};
+
+/** What to do when the queue is full, see srd_session_async_set(). */
+enum {
+	/** Wait until the decode thread has made room. */
+	SRD_ASYNC_BLOCK,
+	/** Throw away the oldest chunks still waiting to be decoded. */
+	SRD_ASYNC_DROP_OLDEST,
+	/** Don't queue the chunk, and return SRD_ERR_BUSY. */
+	SRD_ASYNC_FAIL,
+};
+
 struct srd_decoder {
 	/** The decoder ID. Must be non-NULL and unique for all decoders. */
 	char *id;
@@ -213,9 +234,55 @@ struct srd_decoder_inst {
 	GSList *pd_output;
 	int dec_num_probes;
 	int *dec_probemap;
-	int data_unitsize;
 	uint8_t *probe_samples;
 	GSList *next_di;
+	/*
+	 * The streams of Python output each instance in next_di takes, as
+	 * struct srd_stack_edge, one for every srd_inst_stack_proto() call.
+	 */
+	GSList *next_streams;
+	/* Only hand samples where a mapped probe changed to decode(). */
+	gboolean edges_only;
+	/* Hand whole chunks to decode_block() instead of decode(). */
+	gboolean decode_block;
+	/*
+	 * Queue the packets put() by the instance below, and hand them to
+	 * decode_batch() as a list at the end of each chunk.
+	 */
+	gboolean decode_batch;
+	PyObject *py_batch;
+
+	/* Bound decode() or decode_block() method, see srd_inst_start(). */
+	PyObject *py_decode;
+	/* Bound decode_batch() method, if decode_batch is set. */
+	PyObject *py_decode_batch;
+	/* TRUE once probe_samples holds a sample from a previous iteration. */
+	gboolean got_sample;
+	/*
+	 * With few enough mapped probes, a tuple of prebuilt sample bytes
+	 * objects, indexed by pin_value: bit k of that is the value of the
+	 * k-th mapped probe in the last sample.
+	 */
+	PyObject *py_pin_values;
+	unsigned int pin_value;
+	/*
+	 * The probe map compiled into an extraction plan at start time:
+	 * for each of the num_mapped mapped probes, its index in the PD's
+	 * probe list and the capture probe it's mapped to, and that probe's
+	 * bit plane in the chunk being decoded.
+	 */
+	int num_mapped;
+	int *mapped_index;
+	int *mapped_probes;
+	const uint64_t **mapped_planes;
+	/* Decimation of the samples decode() gets, or NULL. */
+	struct srd_decimator *decim;
+	/*
+	 * Set once decode() kept a view on a raw sample buffer after
+	 * returning. The PD would read freed memory through it, so the
+	 * instance isn't handed any more chunks.
+	 */
+	gboolean view_kept;
 };
 
 struct srd_pd_output {
@@ -223,6 +290,8 @@ struct srd_pd_output {
 	int output_type;
 	struct srd_decoder_inst *di;
 	char *proto_id;
+	/* Only used for OUTPUT_PYTHON: the stacked instances taking it. */
+	GSList *next_di;
 	/* Only used for OUTPUT_META. */
 	const GVariantType *meta_type;
 	char *meta_name;
@@ -248,6 +317,10 @@ struct srd_proto_data_binary {
 typedef void (*srd_pd_output_callback_t)(struct srd_proto_data *pdata,
 					 void *cb_data);
 
+typedef void (*srd_session_decoded_callback_t)(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum, int ret,
+		void *cb_data);
+
 struct srd_pd_callback {
 	int output_type;
 	srd_pd_output_callback_t cb;
@@ -258,18 +331,37 @@ struct srd_pd_callback {
 
 typedef struct {
 	PyObject_HEAD
+	/* The instance this object belongs to, NULL once it is freed. */
+	struct srd_decoder_inst *di;
 } srd_Decoder;
 
 typedef struct {
 	PyObject_HEAD
 	struct srd_decoder_inst *di;
+	struct srd_chunk *chunk;
 	uint64_t start_samplenum;
-	unsigned int itercnt;
+	uint64_t itercnt;
+	/* The run holding sample itercnt, for run-length encoded chunks. */
+	uint64_t run;
 	uint8_t *inbuf;
 	uint64_t inbuflen;
 	PyObject *sample;
+	/* Memoryview over inbuf, which the PD's buffer views are taken from. */
+	PyObject *py_view;
 } srd_logic;
 
+typedef struct {
+	PyObject_HEAD
+	/* One of the CMD_* constants of the sigrokdecode module. */
+	int code;
+	int num_values;
+	/*
+	 * Always two, even for I2C packets which use one: the packet types
+	 * share a free list, so they must all keep the same object size.
+	 */
+	PyObject *values[2];
+} srd_packet;
+
 
 /* srd.c */
 SRD_API int srd_init(const char *path);
@@ -282,7 +374,35 @@ SRD_API int srd_session_metadata_set(struct srd_session *sess, int key,
 		GVariant *data);
 SRD_API int srd_session_send(struct srd_session *sess,
 		uint64_t start_samplenum, uint64_t end_samplenum,
-		const uint8_t *inbuf, uint64_t inbuflen);
+		const uint8_t *inbuf, uint64_t inbuflen, uint64_t unitsize);
+SRD_API int srd_session_send_rle(struct srd_session *sess,
+		uint64_t start_samplenum, const uint8_t *values,
+		const uint64_t *runlengths, uint64_t num_runs,
+		uint64_t unitsize);
+SRD_API int srd_session_send_planar(struct srd_session *sess,
+		uint64_t start_samplenum, const uint8_t **planes,
+		uint64_t num_planes, uint64_t num_samples);
+SRD_API int srd_session_send_events(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint64_t *samplenums, const uint8_t *values,
+		uint64_t num_events, uint64_t unitsize);
+SRD_API int srd_session_send_file(struct srd_session *sess, const char *path,
+		uint64_t offset, uint64_t unitsize);
+SRD_API int srd_session_shm_attach(struct srd_session *sess, const char *name);
+SRD_API int srd_session_shm_decode(struct srd_session *sess, int *closed);
+SRD_API int srd_session_shm_detach(struct srd_session *sess);
+SRD_API int srd_session_window_set(struct srd_session *sess, uint64_t start,
+		uint64_t end);
+SRD_API int srd_session_preroll_get(struct srd_session *sess,
+		uint64_t *preroll);
+SRD_API int srd_session_coalesce_set(struct srd_session *sess,
+		uint64_t bufsize, uint64_t flush_age);
+SRD_API int srd_session_flush(struct srd_session *sess);
+SRD_API int srd_session_async_set(struct srd_session *sess, uint64_t bufsize,
+		int policy, srd_session_decoded_callback_t cb, void *cb_data);
+SRD_API int srd_session_drain(struct srd_session *sess);
+SRD_API int srd_session_glitch_filter_set(struct srd_session *sess,
+		int probe, uint64_t width);
 SRD_API int srd_session_destroy(struct srd_session *sess);
 SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
 		int output_type, srd_pd_output_callback_t cb, void *cb_data);
@@ -303,8 +423,13 @@ SRD_API int srd_inst_probe_set_all(struct srd_decoder_inst *di,
 		GHashTable *probes);
 SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 		const char *id, GHashTable *options);
+SRD_API int srd_inst_decimation_set(struct srd_decoder_inst *di,
+		uint64_t factor, int mode);
 SRD_API int srd_inst_stack(struct srd_session *sess,
 		struct srd_decoder_inst *di_from, struct srd_decoder_inst *di_to);
+SRD_API int srd_inst_stack_proto(struct srd_session *sess,
+		struct srd_decoder_inst *di_from, struct srd_decoder_inst *di_to,
+		const char *proto_id);
 SRD_API struct srd_decoder_inst *srd_inst_find_by_id(struct srd_session *sess,
 		const char *inst_id);
 
@@ -333,6 +458,7 @@ SRD_API int srd_lib_version_age_get(void);
 SRD_API const char *srd_lib_version_string_get(void);
 
 #include "version.h"
+#include "shm_ring.h"
 
 #ifdef __cplusplus
 }
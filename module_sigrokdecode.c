@@ -67,6 +67,9 @@ PyMODINIT_FUNC PyInit_sigrokdecode(void)
 	if (PyModule_AddObject(mod, "srd_logic",
 	    (PyObject *)&srd_logic_type) == -1)
 		return NULL;
+	/* Packet types for OUTPUT_PYTHON, and their CMD_* constants. */
+	if (srd_packet_module_add(mod) == -1)
+		return NULL;
 
 	/* Expose output types as symbols in the sigrokdecode module */
 	if (PyModule_AddIntConstant(mod, "OUTPUT_ANN", SRD_OUTPUT_ANN) == -1)
@@ -22,7 +22,16 @@
 #include "libsigrokdecode-internal.h"
 #include "config.h"
 #include <inttypes.h>
+#include <limits.h>
+#include <string.h>
 #include <glib.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 /**
  * @file
@@ -43,6 +52,13 @@
 SRD_PRIV GSList *sessions = NULL;
 int max_session_id = -1;
 
+/*
+ * While any session decodes in a thread of its own, the frontend's thread
+ * doesn't hold the Python interpreter lock; its state is kept in here.
+ */
+static PyThreadState *async_tstate = NULL;
+static int async_sessions = 0;
+
 /** @endcond */
 
 /** @private */
@@ -55,6 +71,87 @@ SRD_PRIV int session_is_valid(struct srd_session *sess)
 	return SRD_OK;
 }
 
+/* Whether this is the session's decode thread, running a callback. */
+static gboolean session_async_self(struct srd_session *sess)
+{
+	return sess->async_thread && g_thread_self() == sess->async_thread;
+}
+
+/**
+ * Wait until the decode thread has decoded all queued chunks, if the
+ * session has one. Must be called before anything the thread uses is
+ * changed, and before taking the Python interpreter lock, which the
+ * thread needs.
+ *
+ * Called from a callback on the decode thread itself, this doesn't wait
+ * for the chunk being decoded, which would never end. The thread already
+ * holds the interpreter lock then, as a synchronous session's caller does.
+ *
+ * @private
+ */
+SRD_PRIV void session_async_idle(struct srd_session *sess)
+{
+	if (!sess->async_thread || session_async_self(sess))
+		return;
+
+	g_mutex_lock(&sess->async_mutex);
+	while (!g_queue_is_empty(&sess->async_queue) || sess->async_busy)
+		g_cond_wait(&sess->async_cond, &sess->async_mutex);
+	g_mutex_unlock(&sess->async_mutex);
+}
+
+/*
+ * Wait like session_async_idle(), and return the first error the decode
+ * thread ran into since the last call.
+ */
+static int session_async_wait(struct srd_session *sess)
+{
+	int ret;
+
+	if (!sess->async_thread)
+		return SRD_OK;
+
+	session_async_idle(sess);
+	ret = sess->async_ret;
+	sess->async_ret = SRD_OK;
+
+	return ret;
+}
+
+/*
+ * Let the decode thread decode all queued chunks, and end it. Once no
+ * session decodes in a thread any more, the frontend's thread gets the
+ * Python interpreter lock back.
+ */
+static int session_async_stop(struct srd_session *sess)
+{
+	int ret;
+
+	if (!sess->async_thread)
+		return SRD_OK;
+
+	g_mutex_lock(&sess->async_mutex);
+	sess->async_stop = TRUE;
+	g_cond_broadcast(&sess->async_cond);
+	g_mutex_unlock(&sess->async_mutex);
+	g_thread_join(sess->async_thread);
+
+	ret = sess->async_ret;
+	if (sess->async_dropped > 0)
+		srd_warn("Session %d dropped %" PRIu64 " chunks.",
+				sess->session_id, sess->async_dropped);
+	sess->async_thread = NULL;
+	g_mutex_clear(&sess->async_mutex);
+	g_cond_clear(&sess->async_cond);
+
+	if (--async_sessions == 0) {
+		PyEval_RestoreThread(async_tstate);
+		async_tstate = NULL;
+	}
+
+	return ret;
+}
+
 /**
  * Create a decoding session.
  *
@@ -76,10 +173,11 @@ SRD_API int srd_session_new(struct srd_session **sess)
 		return SRD_ERR_ARG;
 	}
 
-	if (!(*sess = g_try_malloc(sizeof(struct srd_session))))
+	if (!(*sess = g_try_malloc0(sizeof(struct srd_session))))
 		return SRD_ERR_MALLOC;
 	(*sess)->session_id = ++max_session_id;
 	(*sess)->di_list = (*sess)->callbacks = NULL;
+	(*sess)->window_end = G_MAXUINT64;
 
 	/* Keep a list of all sessions, so we can clean up as needed. */
 	sessions = g_slist_append(sessions, *sess);
@@ -105,6 +203,7 @@ SRD_API int srd_session_start(struct srd_session *sess)
 {
 	GSList *d;
 	struct srd_decoder_inst *di;
+	PyGILState_STATE gstate;
 	int ret;
 
 	if (session_is_valid(sess) != SRD_OK) {
@@ -112,15 +211,29 @@ SRD_API int srd_session_start(struct srd_session *sess)
 		return SRD_ERR;
 	}
 
+	/* Whatever is still queued belongs to the previous capture. */
+	session_async_idle(sess);
+	sess->async_ret = SRD_OK;
+
 	srd_dbg("Calling start() on all instances in session %d.", sess->session_id);
 
+	/* A new capture has no previous chunk, and nothing pending. */
+	sess->pending_len = 0;
+	sess->held_len = 0;
+	sess->glitch_warned = FALSE;
+	sess->event_unitsize = 0;
+	if (sess->chunk.prev_bits)
+		memset(sess->chunk.prev_bits, 0xff, sess->chunk.unitsize * 8);
+
 	/* Run the start() method on all decoders receiving frontend data. */
 	ret = SRD_OK;
+	gstate = PyGILState_Ensure();
 	for (d = sess->di_list; d; d = d->next) {
 		di = d->data;
 		if ((ret = srd_inst_start(di)) != SRD_OK)
 			break;
 	}
+	PyGILState_Release(gstate);
 
 	return ret;
 }
@@ -130,6 +243,7 @@ SRD_PRIV int srd_inst_send_meta(struct srd_decoder_inst *di, int key,
 		GVariant *data)
 {
 	PyObject *py_ret;
+	uint64_t samplerate;
 
 	if (key != SRD_CONF_SAMPLERATE)
 		/* This is the only key we pass on to the decoder for now. */
@@ -139,9 +253,13 @@ SRD_PRIV int srd_inst_send_meta(struct srd_decoder_inst *di, int key,
 		/* This decoder doesn't want metadata, that's fine. */
 		return SRD_OK;
 
+	/* A decimated instance gets fewer samples per second. */
+	samplerate = g_variant_get_uint64(data);
+	if (di->decim)
+		samplerate /= di->decim->factor;
+
 	py_ret = PyObject_CallMethod(di->py_inst, "metadata", "lK",
-			(long)SRD_CONF_SAMPLERATE,
-			(unsigned long long)g_variant_get_uint64(data));
+			(long)SRD_CONF_SAMPLERATE, (unsigned long long)samplerate);
 	Py_XDECREF(py_ret);
 
 	return SRD_OK;
@@ -164,6 +282,7 @@ SRD_API int srd_session_metadata_set(struct srd_session *sess, int key,
 		GVariant *data)
 {
 	GSList *l;
+	PyGILState_STATE gstate;
 	int ret;
 
 	if (session_is_valid(sess) != SRD_OK) {
@@ -196,121 +315,2039 @@ SRD_API int srd_session_metadata_set(struct srd_session *sess, int key,
 	srd_dbg("Setting session %d samplerate to %"PRIu64".",
 			sess->session_id, g_variant_get_uint64(data));
 
+	session_async_idle(sess);
+
 	ret = SRD_OK;
+	gstate = PyGILState_Ensure();
 	for (l = sess->di_list; l; l = l->next) {
 		if ((ret = srd_inst_send_meta(l->data, key, data)) != SRD_OK)
 			break;
 	}
+	PyGILState_Release(gstate);
 
 	g_variant_unref(data);
 
 	return ret;
 }
 
-/**
- * Send a chunk of logic sample data to a running decoder session.
- *
- * The logic samples must be arranged in probe order, in the least
- * amount of space possible. If no probes were configured, the default
- * probe set consists of all required probes + all optional probes.
- *
- * The size of a sample in inbuf is the minimum number of bytes needed
- * to store the configured (or default) probes.
- *
- * @param sess The session to use.
- * @param start_samplenum The sample number of the first sample in this chunk.
- * @param end_samplenum The sample number of the last sample in this chunk.
- * @param inbuf Pointer to sample data.
- * @param inbuflen Length in bytes of the buffer.
- *
- * @return SRD_OK upon success, a (negative) error code otherwise.
- *
- * @since 0.3.0
+/* The minimum pulse width let through on the given probe. */
+static uint64_t session_glitch_width(const struct srd_session *sess,
+		int probe)
+{
+	if (probe < sess->num_glitch_widths && sess->glitch_widths[probe])
+		return sess->glitch_widths[probe];
+
+	return sess->glitch_width;
+}
+
+/*
+ * The number of samples at the end of a chunk which the glitch filter
+ * can't decide on yet, for the probes used by the session's instances.
  */
-SRD_API int srd_session_send(struct srd_session *sess,
-		uint64_t start_samplenum, uint64_t end_samplenum,
-		const uint8_t *inbuf, uint64_t inbuflen)
+static uint64_t session_glitch_hold(const struct srd_session *sess)
+{
+	const struct srd_chunk *chunk;
+	uint64_t hold, width;
+	int probe;
+
+	chunk = &sess->chunk;
+	hold = 0;
+	for (probe = 0; probe < chunk->unitsize * 8; probe++) {
+		if (!(chunk->lane_masks[probe / 8] & (1 << (probe % 8))))
+			continue;
+		if ((width = session_glitch_width(sess, probe)) > 1)
+			hold = MAX(hold, width - 1);
+	}
+
+	return hold;
+}
+
+/*
+ * Prepare the session's chunk for samples of the given size, and work
+ * out which probes are used by the instances that take input from the
+ * frontend.
+ */
+static int session_chunk_setup(struct srd_session *sess, int unitsize)
 {
+	struct srd_chunk *chunk;
+	struct srd_decoder_inst *di;
 	GSList *d;
+	uint64_t **planes;
+	uint8_t *lane_masks, *prev_bits;
+	PyObject **edges;
+	PyGILState_STATE gstate;
+	int num_planes, probe, i;
+
+	chunk = &sess->chunk;
+	num_planes = unitsize * 8;
+
+	if (unitsize != chunk->unitsize) {
+		if (!(planes = g_try_malloc(sizeof(uint64_t *) * num_planes))) {
+			srd_err("Failed to g_malloc() plane pointers.");
+			return SRD_ERR_MALLOC;
+		}
+		if (!(lane_masks = g_try_malloc(unitsize))) {
+			srd_err("Failed to g_malloc() lane masks.");
+			g_free(planes);
+			return SRD_ERR_MALLOC;
+		}
+		if (!(prev_bits = g_try_malloc(num_planes))) {
+			srd_err("Failed to g_malloc() previous sample.");
+			g_free(lane_masks);
+			g_free(planes);
+			return SRD_ERR_MALLOC;
+		}
+		if (!(edges = g_try_malloc0(sizeof(PyObject *) * num_planes))) {
+			srd_err("Failed to g_malloc() edge index.");
+			g_free(prev_bits);
+			g_free(lane_masks);
+			g_free(planes);
+			return SRD_ERR_MALLOC;
+		}
+		/* 0xff means the previous value is unknown. */
+		memset(prev_bits, 0xff, num_planes);
+		gstate = PyGILState_Ensure();
+		srd_chunk_edges_clear(chunk);
+		PyGILState_Release(gstate);
+		g_free(chunk->planes);
+		g_free(chunk->lane_masks);
+		g_free(chunk->prev_bits);
+		g_free(chunk->edges);
+		chunk->planes = planes;
+		chunk->lane_masks = lane_masks;
+		chunk->prev_bits = prev_bits;
+		chunk->edges = edges;
+		chunk->unitsize = unitsize;
+	}
+	memset(chunk->planes, 0, sizeof(uint64_t *) * num_planes);
+	memset(chunk->lane_masks, 0, unitsize);
+
+	for (d = sess->di_list; d; d = d->next) {
+		di = d->data;
+		for (i = 0; i < di->dec_num_probes; i++) {
+			/* A probemap value of -1 means "unused optional probe". */
+			if ((probe = di->dec_probemap[i]) == -1)
+				continue;
+			if (probe >= num_planes) {
+				srd_err("Instance %s uses probe %d, but samples "
+					"are only %d bytes wide.", di->inst_id,
+					probe, unitsize);
+				return SRD_ERR_ARG;
+			}
+			chunk->lane_masks[probe / 8] |= 1 << (probe % 8);
+		}
+	}
+
+	return SRD_OK;
+}
+
+/*
+ * Put the samples held back for the glitch filter in front of the chunk,
+ * whose planes must have room for them.
+ */
+static void session_held_prepend(struct srd_session *sess)
+{
+	struct srd_chunk *chunk;
+	int probe;
+
+	chunk = &sess->chunk;
+	if (sess->held_len == 0)
+		return;
+
+	for (probe = 0; probe < chunk->unitsize * 8; probe++) {
+		if (chunk->planes[probe])
+			srd_plane_prepend(chunk->planes[probe],
+					chunk->num_samples, sess->held +
+					probe * sess->held_words,
+					sess->held_len);
+	}
+	chunk->start_samplenum = sess->held_start;
+	chunk->num_samples += sess->held_len;
+	sess->held_len = 0;
+}
+
+/*
+ * Unpack a chunk of samples into the session's bit planes, once for all
+ * instances that take input from the frontend. Only the probes those
+ * instances have mapped are unpacked. Samples held back for the glitch
+ * filter go in front of them.
+ */
+static int session_unpack(struct srd_session *sess, uint64_t start_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen, int unitsize)
+{
+	struct srd_chunk *chunk;
+	uint64_t *plane_buf, words;
+	int num_planes, probe, i, ret;
+
+	if ((ret = session_chunk_setup(sess, unitsize)) != SRD_OK)
+		return ret;
+
+	chunk = &sess->chunk;
+	num_planes = unitsize * 8;
+	chunk->format = SRD_CHUNK_PLANES;
+	chunk->start_samplenum = start_samplenum;
+	chunk->num_samples = inbuflen / unitsize;
+	words = (chunk->num_samples + sess->held_len + 63) / 64;
+
+	/* Lay out the used planes back to back in the backing store. */
+	for (probe = 0, i = 0; probe < num_planes; probe++) {
+		if (chunk->lane_masks[probe / 8] & (1 << (probe % 8)))
+			i++;
+	}
+	if (i * words > chunk->plane_buf_words) {
+		if (!(plane_buf = g_try_realloc(chunk->plane_buf,
+				sizeof(uint64_t) * i * words))) {
+			srd_err("Failed to g_malloc() bit planes.");
+			return SRD_ERR_MALLOC;
+		}
+		chunk->plane_buf = plane_buf;
+		chunk->plane_buf_words = i * words;
+	}
+	for (probe = 0, i = 0; probe < num_planes; probe++) {
+		if (chunk->lane_masks[probe / 8] & (1 << (probe % 8)))
+			chunk->planes[probe] = chunk->plane_buf + words * i++;
+	}
+
+	srd_unpack_planes(chunk->planes, inbuf, chunk->num_samples, unitsize,
+			chunk->lane_masks);
+	session_held_prepend(sess);
+
+	return SRD_OK;
+}
+
+/* Prepare the session's chunk for the given number of runs. */
+static int session_runs_setup(struct srd_session *sess, uint64_t num_runs,
+		int unitsize)
+{
+	struct srd_chunk *chunk;
+	uint64_t *run_starts;
 	int ret;
 
-	if (session_is_valid(sess) != SRD_OK) {
-		srd_err("Invalid session.");
+	if ((ret = session_chunk_setup(sess, unitsize)) != SRD_OK)
+		return ret;
+
+	chunk = &sess->chunk;
+	if (num_runs > chunk->run_starts_len) {
+		if (!(run_starts = g_try_realloc(chunk->run_starts,
+				sizeof(uint64_t) * num_runs))) {
+			srd_err("Failed to g_malloc() runs.");
+			return SRD_ERR_MALLOC;
+		}
+		chunk->run_starts = run_starts;
+		chunk->run_starts_len = num_runs;
+	}
+
+	return SRD_OK;
+}
+
+/*
+ * Take the value the events continue from out of the last sample
+ * decoded, for a session that was sent raw samples before. Only the
+ * probes the decoders use are known, the others are left low.
+ */
+static int session_event_value_seed(struct srd_session *sess, int unitsize)
+{
+	struct srd_chunk *chunk;
+	uint8_t *event_value;
+	int probe;
+
+	chunk = &sess->chunk;
+	if (!chunk->prev_bits || chunk->unitsize != unitsize)
 		return SRD_ERR_ARG;
+	for (probe = 0; probe < unitsize * 8; probe++) {
+		if ((chunk->lane_masks[probe / 8] & (1 << (probe % 8))) &&
+				chunk->prev_bits[probe] == 0xff)
+			return SRD_ERR_ARG;
 	}
 
-	srd_dbg("Calling decode() on all instances with starting sample "
-			"number %" PRIu64 ", %" PRIu64 " bytes at 0x%p",
-			start_samplenum, inbuflen, inbuf);
+	if (!(event_value = g_try_malloc0(unitsize))) {
+		srd_err("Failed to g_malloc() event value.");
+		return SRD_ERR_MALLOC;
+	}
+	for (probe = 0; probe < unitsize * 8; probe++) {
+		if (chunk->prev_bits[probe] == 1)
+			event_value[probe / 8] |= 1 << (probe % 8);
+	}
+	g_free(sess->event_value);
+	sess->event_value = event_value;
+	sess->event_unitsize = unitsize;
 
-	for (d = sess->di_list; d; d = d->next) {
-		if ((ret = srd_inst_decode(d->data, start_samplenum,
-				end_samplenum, inbuf, inbuflen)) != SRD_OK)
-			return ret;
+	return SRD_OK;
+}
+
+/*
+ * Set up the session's chunk with the samples start_samplenum up to
+ * end_samplenum, given as the events at which they change. Each event's
+ * value holds until the next one, so they become runs. If the first event
+ * comes after start_samplenum, the value of the last event sent before,
+ * or else of the last sample sent before, leads the chunk as a run of
+ * its own.
+ */
+static int session_events(struct srd_session *sess, uint64_t start_samplenum,
+		uint64_t end_samplenum, const uint64_t *samplenums,
+		const uint8_t *values, uint64_t num_events, int unitsize)
+{
+	struct srd_chunk *chunk;
+	const uint8_t *run_values;
+	uint8_t *event_runs;
+	uint64_t num_runs, lead, e;
+	int ret;
+
+	/* Nothing may change before the events are known to be good. */
+	for (e = 0; e < num_events; e++) {
+		if (samplenums[e] < start_samplenum ||
+				samplenums[e] >= end_samplenum ||
+				(e > 0 && samplenums[e] <= samplenums[e - 1])) {
+			srd_err("Event %" PRIu64 " at sample %" PRIu64 " is out "
+					"of order.", e, samplenums[e]);
+			return SRD_ERR_ARG;
+		}
+	}
+
+	lead = num_events == 0 || samplenums[0] > start_samplenum;
+	if (lead && sess->event_unitsize != unitsize &&
+			(ret = session_event_value_seed(sess, unitsize)) != SRD_OK) {
+		if (ret == SRD_ERR_ARG)
+			srd_err("The value at sample %" PRIu64 " is unknown.",
+					start_samplenum);
+		return ret;
+	}
+
+	num_runs = num_events + lead;
+	if ((ret = session_runs_setup(sess, num_runs, unitsize)) != SRD_OK)
+		return ret;
+
+	chunk = &sess->chunk;
+	run_values = values;
+	if (lead) {
+		if (num_runs * unitsize > sess->event_runs_len) {
+			if (!(event_runs = g_try_realloc(sess->event_runs,
+					num_runs * unitsize))) {
+				srd_err("Failed to g_malloc() event values.");
+				return SRD_ERR_MALLOC;
+			}
+			sess->event_runs = event_runs;
+			sess->event_runs_len = num_runs * unitsize;
+		}
+		memcpy(sess->event_runs, sess->event_value, unitsize);
+		if (num_events > 0)
+			memcpy(sess->event_runs + unitsize, values,
+					num_events * unitsize);
+		run_values = sess->event_runs;
+		chunk->run_starts[0] = 0;
+	}
+
+	for (e = 0; e < num_events; e++)
+		chunk->run_starts[e + lead] = samplenums[e] - start_samplenum;
+
+	/* The last value holds until the next event. */
+	if (sess->event_unitsize != unitsize) {
+		g_free(sess->event_value);
+		sess->event_unitsize = 0;
+		if (!(sess->event_value = g_try_malloc(unitsize))) {
+			srd_err("Failed to g_malloc() event value.");
+			return SRD_ERR_MALLOC;
+		}
+	}
+	memcpy(sess->event_value, run_values + (num_runs - 1) * unitsize,
+			unitsize);
+	sess->event_unitsize = unitsize;
+
+	chunk->format = SRD_CHUNK_RUNS;
+	chunk->start_samplenum = start_samplenum;
+	chunk->num_samples = end_samplenum - start_samplenum;
+	chunk->num_runs = num_runs;
+	chunk->run_values = run_values;
+
+	return SRD_OK;
+}
+
+/*
+ * Set up the session's chunk with run-length encoded samples. Nothing
+ * gets expanded, the runs are only indexed by their starting sample.
+ */
+static int session_runs(struct srd_session *sess, uint64_t start_samplenum,
+		const uint8_t *values, const uint64_t *runlengths,
+		uint64_t num_runs, int unitsize)
+{
+	struct srd_chunk *chunk;
+	uint64_t start, r;
+	int ret;
+
+	if ((ret = session_runs_setup(sess, num_runs, unitsize)) != SRD_OK)
+		return ret;
+
+	chunk = &sess->chunk;
+	for (r = 0, start = 0; r < num_runs; r++) {
+		if (runlengths[r] == 0) {
+			srd_err("Run %" PRIu64 " is empty.", r);
+			return SRD_ERR_ARG;
+		}
+		chunk->run_starts[r] = start;
+		start += runlengths[r];
+	}
+
+	chunk->format = SRD_CHUNK_RUNS;
+	chunk->start_samplenum = start_samplenum;
+	chunk->num_samples = start;
+	chunk->num_runs = num_runs;
+	chunk->run_values = values;
+
+	return SRD_OK;
+}
+
+/*
+ * Set up the session's chunk with one bitstream per probe. Where a stream
+ * is already laid out like a bit plane, it is used in place; the others
+ * are copied. Samples held back for the glitch filter go in front of them.
+ */
+static int session_planar(struct srd_session *sess, uint64_t start_samplenum,
+		const uint8_t **streams, uint64_t num_streams,
+		uint64_t num_samples)
+{
+	struct srd_chunk *chunk;
+	uint64_t *plane_buf, words, w;
+	int num_planes, probe, i, ret;
+	gboolean in_place;
+
+	if ((ret = session_chunk_setup(sess, (num_streams + 7) / 8)) != SRD_OK)
+		return ret;
+
+	chunk = &sess->chunk;
+	num_planes = chunk->unitsize * 8;
+	words = (num_samples + sess->held_len + 63) / 64;
+
+	/*
+	 * A stream can only be used in place if its last word can be read
+	 * without running past its end, and it has the same byte order
+	 * as the planes. Only the glitch filter writes to the planes, or
+	 * moves them to make room for held back samples.
+	 */
+	in_place = G_BYTE_ORDER == G_LITTLE_ENDIAN && num_samples % 64 == 0 &&
+			session_glitch_hold(sess) == 0 && sess->held_len == 0;
+
+	for (probe = 0, i = 0; probe < num_planes; probe++) {
+		if (!(chunk->lane_masks[probe / 8] & (1 << (probe % 8))))
+			continue;
+		if ((uint64_t)probe >= num_streams || !streams[probe]) {
+			srd_err("No bitstream for probe %d.", probe);
+			return SRD_ERR_ARG;
+		}
+		if (!in_place || (uintptr_t)streams[probe] % sizeof(uint64_t))
+			i++;
+	}
+	if (i * words > chunk->plane_buf_words) {
+		if (!(plane_buf = g_try_realloc(chunk->plane_buf,
+				sizeof(uint64_t) * i * words))) {
+			srd_err("Failed to g_malloc() bit planes.");
+			return SRD_ERR_MALLOC;
+		}
+		chunk->plane_buf = plane_buf;
+		chunk->plane_buf_words = i * words;
+	}
+
+	for (probe = 0, i = 0; probe < num_planes; probe++) {
+		if (!(chunk->lane_masks[probe / 8] & (1 << (probe % 8))))
+			continue;
+		if (in_place && !((uintptr_t)streams[probe] % sizeof(uint64_t))) {
+			chunk->planes[probe] = (uint64_t *)streams[probe];
+			continue;
+		}
+		chunk->planes[probe] = chunk->plane_buf + words * i++;
+		chunk->planes[probe][(num_samples + 63) / 64 - 1] = 0;
+		memcpy(chunk->planes[probe], streams[probe],
+				(num_samples + 7) / 8);
+		for (w = 0; w < (num_samples + 63) / 64; w++)
+			chunk->planes[probe][w] =
+				GUINT64_FROM_LE(chunk->planes[probe][w]);
 	}
 
+	chunk->format = SRD_CHUNK_PLANES;
+	chunk->start_samplenum = start_samplenum;
+	chunk->num_samples = num_samples;
+	session_held_prepend(sess);
+
 	return SRD_OK;
 }
 
 /**
- * Destroy a decoding session.
+ * Get the sample numbers of all changes of a probe within a chunk.
  *
- * All decoder instances and output callbacks are properly released.
+ * The list is built on first use, and then shared by all instances which
+ * decode the chunk, until srd_chunk_edges_clear() is called for the next
+ * chunk.
  *
- * @param sess The session to be destroyed.
+ * @param chunk The chunk to search.
+ * @param probe The probe to search.
  *
- * @return SRD_OK upon success, a (negative) error code otherwise.
+ * @return A borrowed reference to a bytes object holding the sample
+ *         numbers as an array of uint64_t in ascending order, or NULL
+ *         with a Python exception set upon error.
  *
- * @since 0.3.0
+ * @private
  */
-SRD_API int srd_session_destroy(struct srd_session *sess)
+SRD_PRIV PyObject *srd_chunk_edges(struct srd_chunk *chunk, int probe)
 {
-	int session_id;
-
-	if (!sess) {
-		srd_err("Invalid session.");
-		return SRD_ERR_ARG;
-	}
+	PyObject *py_edges;
+	uint64_t num_edges;
 
-	session_id = sess->session_id;
-	if (sess->di_list)
-		srd_inst_free_all(sess, NULL);
-	if (sess->callbacks)
-		g_slist_free_full(sess->callbacks, g_free);
-	sessions = g_slist_remove(sessions, sess);
-	g_free(sess);
+	if (chunk->edges[probe])
+		return chunk->edges[probe];
 
-	srd_dbg("Destroyed session %d.", session_id);
+	num_edges = srd_find_edges(NULL, chunk, probe);
+	if (!(py_edges = PyBytes_FromStringAndSize(NULL,
+			sizeof(uint64_t) * num_edges)))
+		return NULL;
+	srd_find_edges((uint64_t *)PyBytes_AS_STRING(py_edges), chunk, probe);
+	chunk->edges[probe] = py_edges;
 
-	return SRD_OK;
+	return py_edges;
 }
 
 /**
- * Register/add a decoder output callback function.
- *
- * The function will be called when a protocol decoder sends output back
- * to the PD controller (except for Python objects, which only go up the
- * stack).
+ * Drop the lists built by srd_chunk_edges(), once the chunk changes.
  *
- * @param sess The output session in which to register the callback.
- * @param output_type The output type this callback will receive. Only one
- *                    callback per output type can be registered.
- * @param cb The function to call. Must not be NULL.
- * @param cb_data Private data for the callback function. Can be NULL.
+ * @param chunk The chunk.
  *
- * @since 0.3.0
+ * @private
  */
-SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
-		int output_type, srd_pd_output_callback_t cb, void *cb_data)
+SRD_PRIV void srd_chunk_edges_clear(struct srd_chunk *chunk)
 {
-	struct srd_pd_callback *pd_cb;
+	int probe;
 
-	if (session_is_valid(sess) != SRD_OK) {
-		srd_err("Invalid session.");
-		return SRD_ERR_ARG;
+	if (!chunk->edges)
+		return;
+
+	for (probe = 0; probe < chunk->unitsize * 8; probe++)
+		Py_CLEAR(chunk->edges[probe]);
+}
+
+/* Run all instances which take input from the frontend over the chunk. */
+static int session_decode(struct srd_session *sess, uint64_t end_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen)
+{
+	struct srd_chunk *chunk;
+	PyGILState_STATE gstate;
+	GSList *d;
+	uint64_t last;
+	int num_planes, probe, ret;
+
+	chunk = &sess->chunk;
+	num_planes = chunk->unitsize * 8;
+
+	if (chunk->format == SRD_CHUNK_RUNS && !sess->glitch_warned &&
+			session_glitch_hold(sess) > 0) {
+		srd_warn("Session %d doesn't filter glitches out of "
+				"run-length encoded samples.", sess->session_id);
+		sess->glitch_warned = TRUE;
 	}
 
-	srd_dbg("Registering new callback for output type %d.", output_type);
+	gstate = PyGILState_Ensure();
+	srd_chunk_edges_clear(chunk);
+
+	/* Without a previous sample, the first one has no edge. */
+	for (probe = 0; probe < num_planes; probe++) {
+		if (!(chunk->lane_masks[probe / 8] & (1 << (probe % 8))))
+			continue;
+		if (chunk->prev_bits[probe] == 0xff)
+			chunk->prev_bits[probe] = srd_chunk_bit(chunk, probe, 0, 0);
+	}
+
+	ret = SRD_OK;
+	for (d = sess->di_list; d; d = d->next) {
+		if ((ret = srd_inst_decode(d->data, chunk->start_samplenum,
+				end_samplenum, inbuf, inbuflen)) != SRD_OK)
+			break;
+	}
+	PyGILState_Release(gstate);
+	if (ret != SRD_OK)
+		return ret;
+
+	/* Remember the last sample, for the next chunk. */
+	last = chunk->format == SRD_CHUNK_RUNS ? chunk->num_runs - 1 : 0;
+	for (probe = 0; probe < num_planes; probe++) {
+		if (chunk->lane_masks[probe / 8] & (1 << (probe % 8)))
+			chunk->prev_bits[probe] = srd_chunk_bit(chunk, probe,
+					chunk->num_samples - 1, last);
+		else
+			chunk->prev_bits[probe] = 0xff;
+	}
+
+	return SRD_OK;
+}
+
+/*
+ * Run the glitch filter over a chunk of bit planes, and decode it. Unless
+ * this is the end of the samples, the last samples the filter can't
+ * decide on yet are held back unfiltered, and decoded in front of the
+ * next chunk instead. That way every change which gets through keeps its
+ * sample number, wherever the chunks were split.
+ */
+static int session_decode_planes(struct srd_session *sess,
+		uint64_t end_samplenum, const uint8_t *inbuf, uint64_t inbuflen,
+		gboolean last)
+{
+	struct srd_chunk *chunk;
+	uint64_t *held, hold, words, width;
+	int num_planes, probe;
+
+	chunk = &sess->chunk;
+	num_planes = chunk->unitsize * 8;
+	if ((hold = session_glitch_hold(sess)) == 0)
+		return session_decode(sess, end_samplenum, inbuf, inbuflen);
+
+	hold = last ? 0 : MIN(hold, chunk->num_samples);
+	if (hold > 0) {
+		words = (hold + 63) / 64;
+		if (num_planes * words > sess->held_buf_words) {
+			if (!(held = g_try_malloc(sizeof(uint64_t) *
+					num_planes * words))) {
+				srd_err("Failed to g_malloc() held back "
+						"samples.");
+				return SRD_ERR_MALLOC;
+			}
+			g_free(sess->held);
+			sess->held = held;
+			sess->held_buf_words = num_planes * words;
+		}
+		sess->held_words = words;
+		for (probe = 0; probe < num_planes; probe++) {
+			if (chunk->planes[probe])
+				srd_plane_copy(sess->held +
+						probe * sess->held_words,
+						chunk->planes[probe],
+						chunk->num_samples - hold, hold);
+		}
+		sess->held_start = chunk->start_samplenum +
+				chunk->num_samples - hold;
+		sess->held_len = hold;
+	}
+
+	if (chunk->num_samples == hold)
+		return SRD_OK;
+
+	for (probe = 0; probe < num_planes; probe++) {
+		if (chunk->planes[probe] &&
+				(width = session_glitch_width(sess, probe)) > 1)
+			srd_glitch_filter(chunk->planes[probe],
+					chunk->num_samples, width,
+					chunk->prev_bits[probe]);
+	}
+	chunk->num_samples -= hold;
+
+	/* The raw buffer doesn't match the filtered samples. */
+	return session_decode(sess,
+			chunk->start_samplenum + chunk->num_samples, NULL, 0);
+}
+
+/*
+ * Decode the samples held back for the glitch filter, as the end of the
+ * samples: changes which haven't lasted long enough by then are dropped.
+ */
+static int session_held_flush(struct srd_session *sess)
+{
+	struct srd_chunk *chunk;
+	int probe;
+
+	if (sess->held_len == 0)
+		return SRD_OK;
+
+	chunk = &sess->chunk;
+	chunk->format = SRD_CHUNK_PLANES;
+	chunk->start_samplenum = sess->held_start;
+	chunk->num_samples = sess->held_len;
+	for (probe = 0; probe < chunk->unitsize * 8; probe++) {
+		if (chunk->lane_masks[probe / 8] & (1 << (probe % 8)))
+			chunk->planes[probe] = sess->held +
+					probe * sess->held_words;
+	}
+	/* Nothing is held back any more, even if decoding fails. */
+	sess->held_len = 0;
+
+	return session_decode_planes(sess,
+			chunk->start_samplenum + chunk->num_samples, NULL, 0,
+			TRUE);
+}
+
+/*
+ * Decode the samples held back for the glitch filter first, unless the
+ * given chunk follows on from them.
+ */
+static int session_held_follow(struct srd_session *sess,
+		uint64_t start_samplenum, int unitsize)
+{
+	if (sess->held_len == 0 || (unitsize == sess->chunk.unitsize &&
+			start_samplenum == sess->held_start + sess->held_len))
+		return SRD_OK;
+
+	return session_held_flush(sess);
+}
+
+/* Unpack a chunk of raw samples, and decode it. */
+static int session_send(struct srd_session *sess, uint64_t start_samplenum,
+		uint64_t end_samplenum, const uint8_t *inbuf, uint64_t inbuflen,
+		uint64_t unitsize)
+{
+	int ret;
+
+	if ((ret = session_held_follow(sess, start_samplenum,
+			(int)unitsize)) != SRD_OK)
+		return ret;
+
+	if ((ret = session_unpack(sess, start_samplenum, inbuf,
+			inbuflen, (int)unitsize)) != SRD_OK)
+		return ret;
+
+	return session_decode_planes(sess, end_samplenum, inbuf, inbuflen,
+			FALSE);
+}
+
+/* Decode the samples held back by coalescing. */
+static int session_flush(struct srd_session *sess)
+{
+	uint64_t len;
+
+	if (sess->pending_len == 0)
+		return SRD_OK;
+
+	/* Nothing is pending any more, even if decoding fails. */
+	len = sess->pending_len;
+	sess->pending_len = 0;
+
+	return session_send(sess, sess->pending_start, sess->pending_start +
+			len / sess->pending_unitsize, sess->pending, len,
+			sess->pending_unitsize);
+}
+
+/*
+ * Add a chunk of raw samples to the pending ones, and decode them all once
+ * enough have been collected, or the oldest of them are old enough by the
+ * time this chunk comes in.
+ * Chunks which don't follow on from the pending ones, and chunks which are
+ * big enough by themselves, are not copied.
+ */
+static int session_coalesce(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen, uint64_t unitsize)
+{
+	int ret;
+
+	/* Only whole samples can be merged with the next chunk. */
+	inbuflen -= inbuflen % unitsize;
+
+	if (sess->pending_len > 0 && (unitsize != sess->pending_unitsize ||
+			start_samplenum != sess->pending_start +
+			sess->pending_len / sess->pending_unitsize)) {
+		if ((ret = session_flush(sess)) != SRD_OK)
+			return ret;
+	}
+
+	if (sess->pending_len + inbuflen > sess->coalesce_size) {
+		if ((ret = session_flush(sess)) != SRD_OK)
+			return ret;
+		if (inbuflen >= sess->coalesce_size)
+			return session_send(sess, start_samplenum,
+					end_samplenum, inbuf, inbuflen,
+					unitsize);
+	}
+
+	if (sess->pending_len == 0) {
+		sess->pending_start = start_samplenum;
+		sess->pending_unitsize = unitsize;
+		sess->pending_since = g_get_monotonic_time();
+	}
+	memcpy(sess->pending + sess->pending_len, inbuf, inbuflen);
+	sess->pending_len += inbuflen;
+
+	if (sess->pending_len == sess->coalesce_size ||
+			(sess->coalesce_age > 0 &&
+			g_get_monotonic_time() - sess->pending_since >=
+			sess->coalesce_age))
+		return session_flush(sess);
+
+	return SRD_OK;
+}
+
+/* A chunk of raw samples passed to srd_session_send(), for coalescing. */
+static int session_send_raw(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen, uint64_t unitsize)
+{
+	if (sess->coalesce_size > 0)
+		return session_coalesce(sess, start_samplenum, end_samplenum,
+				inbuf, inbuflen, unitsize);
+
+	return session_send(sess, start_samplenum, end_samplenum, inbuf,
+			inbuflen, unitsize);
+}
+
+/*
+ * Wait for the decode thread to decode all queued chunks, and decode the
+ * samples held back by coalescing, before samples are sent by other means.
+ */
+static int session_flush_pending(struct srd_session *sess)
+{
+	int ret, flushed;
+
+	ret = session_async_wait(sess);
+	flushed = session_flush(sess);
+
+	return ret != SRD_OK ? ret : flushed;
+}
+
+/** @cond PRIVATE */
+/* A copy of a chunk passed to srd_session_send(), in the async queue. */
+struct async_chunk {
+	uint64_t start_samplenum;
+	uint64_t end_samplenum;
+	uint64_t unitsize;
+	uint64_t len;
+	uint8_t *data;
+};
+/** @endcond */
+
+/* Decode the queued chunks in order, until told to stop. */
+static gpointer session_async_thread(gpointer data)
+{
+	struct srd_session *sess;
+	struct async_chunk *ac;
+	int ret;
+
+	sess = data;
+	g_mutex_lock(&sess->async_mutex);
+	while (TRUE) {
+		while (g_queue_is_empty(&sess->async_queue) && !sess->async_stop)
+			g_cond_wait(&sess->async_cond, &sess->async_mutex);
+		if (!(ac = g_queue_pop_head(&sess->async_queue)))
+			break;
+		sess->async_queued -= ac->len;
+		sess->async_busy = TRUE;
+		g_cond_broadcast(&sess->async_cond);
+		g_mutex_unlock(&sess->async_mutex);
+
+		ret = session_send_raw(sess, ac->start_samplenum,
+				ac->end_samplenum, ac->data, ac->len,
+				ac->unitsize);
+		if (sess->async_cb)
+			sess->async_cb(sess, ac->start_samplenum,
+					ac->end_samplenum, ret,
+					sess->async_cb_data);
+		g_free(ac);
+
+		g_mutex_lock(&sess->async_mutex);
+		if (ret != SRD_OK && sess->async_ret == SRD_OK)
+			sess->async_ret = ret;
+		sess->async_busy = FALSE;
+		g_cond_broadcast(&sess->async_cond);
+	}
+	g_mutex_unlock(&sess->async_mutex);
+
+	return NULL;
+}
+
+/*
+ * Queue a copy of a chunk for the decode thread, making room for it as the
+ * session's policy says. A chunk bigger than the whole queue can only go
+ * in once the queue is empty. Errors of the decode thread are returned
+ * here, once.
+ */
+static int session_async_queue(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen, uint64_t unitsize)
+{
+	struct async_chunk *ac, *old;
+	int ret;
+
+	if (!(ac = g_try_malloc(sizeof(struct async_chunk) + inbuflen))) {
+		srd_err("Failed to g_malloc() queued chunk.");
+		return SRD_ERR_MALLOC;
+	}
+	ac->start_samplenum = start_samplenum;
+	ac->end_samplenum = end_samplenum;
+	ac->unitsize = unitsize;
+	ac->len = inbuflen;
+	ac->data = (uint8_t *)(ac + 1);
+	memcpy(ac->data, inbuf, inbuflen);
+
+	g_mutex_lock(&sess->async_mutex);
+	if ((ret = sess->async_ret) != SRD_OK) {
+		sess->async_ret = SRD_OK;
+		g_mutex_unlock(&sess->async_mutex);
+		g_free(ac);
+		return ret;
+	}
+
+	while (sess->async_queued > 0 &&
+			sess->async_queued + inbuflen > sess->async_size) {
+		/* The decode thread would wait for itself to make room. */
+		if (sess->async_policy == SRD_ASYNC_FAIL ||
+				session_async_self(sess)) {
+			g_mutex_unlock(&sess->async_mutex);
+			g_free(ac);
+			srd_dbg("Session %d queue is full.", sess->session_id);
+			return SRD_ERR_BUSY;
+		} else if (sess->async_policy == SRD_ASYNC_DROP_OLDEST) {
+			old = g_queue_pop_head(&sess->async_queue);
+			sess->async_queued -= old->len;
+			sess->async_dropped++;
+			g_free(old);
+		} else {
+			g_cond_wait(&sess->async_cond, &sess->async_mutex);
+		}
+	}
+
+	g_queue_push_tail(&sess->async_queue, ac);
+	sess->async_queued += inbuflen;
+	g_cond_broadcast(&sess->async_cond);
+	g_mutex_unlock(&sess->async_mutex);
+
+	return SRD_OK;
+}
+
+/**
+ * Send a chunk of logic sample data to a running decoder session.
+ *
+ * The logic samples must be arranged in probe order, with probe n in
+ * bit n % 8 of byte n / 8 of each sample, exactly as captured. If no
+ * probes were configured, the default probe set consists of all required
+ * probes + all optional probes, mapped to probes 0 and up.
+ *
+ * The chunk is unpacked only once for all instances in the session, so
+ * each of them only needs to have its probes mapped to the capture's
+ * probes, whatever the width of the capture.
+ *
+ * If coalescing was set up with srd_session_coalesce_set(), the chunk may
+ * be held back, and decoded later together with the chunks following it.
+ *
+ * If asynchronous decoding was set up with srd_session_async_set(), the
+ * chunk is copied into the session's queue, and decoded in the session's
+ * own thread. This returns any error the thread ran into since the
+ * previous call.
+ *
+ * @param sess The session to use.
+ * @param start_samplenum The sample number of the first sample in this chunk.
+ * @param end_samplenum The sample number of the last sample in this chunk.
+ * @param inbuf Pointer to sample data. Must not be NULL.
+ * @param inbuflen Length in bytes of the buffer. Must be at least unitsize.
+ * @param unitsize The number of bytes per sample.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_send(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint8_t *inbuf, uint64_t inbuflen, uint64_t unitsize)
+{
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (unitsize == 0 || unitsize > INT_MAX / 8) {
+		srd_err("Invalid unitsize %" PRIu64 ".", unitsize);
+		return SRD_ERR_ARG;
+	}
+
+	if (!inbuf || inbuflen < unitsize) {
+		srd_err("Invalid sample buffer.");
+		return SRD_ERR_ARG;
+	}
+
+	srd_dbg("Calling decode() on all instances with starting sample "
+			"number %" PRIu64 ", %" PRIu64 " bytes at 0x%p",
+			start_samplenum, inbuflen, inbuf);
+
+	if (!sess->di_list)
+		return SRD_OK;
+
+	if (sess->async_thread)
+		return session_async_queue(sess, start_samplenum,
+				end_samplenum, inbuf, inbuflen, unitsize);
+
+	return session_send_raw(sess, start_samplenum, end_samplenum, inbuf,
+			inbuflen, unitsize);
+}
+
+/**
+ * Send a chunk of run-length encoded logic sample data to a running
+ * decoder session.
+ *
+ * Run r of the chunk consists of runlengths[r] consecutive samples, all
+ * of which have the value found at values + r * unitsize. The values are
+ * arranged like the samples passed to srd_session_send(). The runs are
+ * not expanded into raw samples; decoders iterating in edges-only mode
+ * only see one sample per run.
+ *
+ * Decoders have no access to a raw sample buffer for these chunks.
+ *
+ * @param sess The session to use.
+ * @param start_samplenum The sample number of the first sample in this chunk.
+ * @param values Pointer to the value of each run. Must not be NULL.
+ * @param runlengths Pointer to the number of samples in each run. None of
+ *                   them may be 0. Must not be NULL.
+ * @param num_runs Number of runs in this chunk. Must be > 0.
+ * @param unitsize The number of bytes per value.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_send_rle(struct srd_session *sess,
+		uint64_t start_samplenum, const uint8_t *values,
+		const uint64_t *runlengths, uint64_t num_runs,
+		uint64_t unitsize)
+{
+	int ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (unitsize == 0 || unitsize > INT_MAX / 8) {
+		srd_err("Invalid unitsize %" PRIu64 ".", unitsize);
+		return SRD_ERR_ARG;
+	}
+
+	if (!values || !runlengths || num_runs == 0) {
+		srd_err("Invalid runs.");
+		return SRD_ERR_ARG;
+	}
+
+	srd_dbg("Calling decode() on all instances with starting sample "
+			"number %" PRIu64 ", %" PRIu64 " runs at 0x%p",
+			start_samplenum, num_runs, values);
+
+	if (!sess->di_list)
+		return SRD_OK;
+
+	if ((ret = srd_session_flush(sess)) != SRD_OK)
+		return ret;
+
+	if ((ret = session_runs(sess, start_samplenum, values, runlengths,
+			num_runs, (int)unitsize)) != SRD_OK)
+		return ret;
+
+	return session_decode(sess,
+			start_samplenum + sess->chunk.num_samples, NULL, 0);
+}
+
+/**
+ * Send a chunk of logic sample data to a running decoder session, as one
+ * bitstream per probe.
+ *
+ * Sample n of probe p is found in bit n % 8 of byte n / 8 of planes[p].
+ * Decoders read their probes straight from these streams, without any
+ * interleaving or unpacking. Streams which are aligned to 8 bytes are not
+ * even copied, if the chunk holds a multiple of 64 samples.
+ *
+ * Decoders have no access to a raw sample buffer for these chunks.
+ *
+ * @param sess The session to use.
+ * @param start_samplenum The sample number of the first sample in this chunk.
+ * @param planes Array of num_planes pointers to the bitstream of each probe.
+ *               Streams of probes not used by any decoder may be NULL.
+ *               Must not be NULL.
+ * @param num_planes Number of probes in planes.
+ * @param num_samples Number of samples in each stream. Must be > 0.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_send_planar(struct srd_session *sess,
+		uint64_t start_samplenum, const uint8_t **planes,
+		uint64_t num_planes, uint64_t num_samples)
+{
+	int ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (!planes || num_planes == 0 || num_planes > INT_MAX - 7) {
+		srd_err("Invalid bitstreams.");
+		return SRD_ERR_ARG;
+	}
+
+	if (num_samples == 0) {
+		srd_err("Invalid number of samples.");
+		return SRD_ERR_ARG;
+	}
+
+	srd_dbg("Calling decode() on all instances with starting sample "
+			"number %" PRIu64 ", %" PRIu64 " samples of %" PRIu64
+			" probes", start_samplenum, num_samples, num_planes);
+
+	if (!sess->di_list)
+		return SRD_OK;
+
+	if ((ret = session_flush_pending(sess)) != SRD_OK)
+		return ret;
+
+	if ((ret = session_held_follow(sess, start_samplenum,
+			(int)((num_planes + 7) / 8))) != SRD_OK)
+		return ret;
+
+	if ((ret = session_planar(sess, start_samplenum, planes, num_planes,
+			num_samples)) != SRD_OK)
+		return ret;
+
+	return session_decode_planes(sess, start_samplenum + num_samples,
+			NULL, 0, FALSE);
+}
+
+/**
+ * Send a chunk of logic samples to a running decoder session, as the
+ * events at which they change.
+ *
+ * This suits analyzers which only store changes, with arbitrary gaps in
+ * between. Event e says that from sample samplenums[e] on, the samples
+ * have the value at values + e * unitsize, up to the next event. The
+ * value of the last event holds until the next chunk's first event.
+ *
+ * Nothing gets expanded into uniform samples. Decoders iterating in
+ * edges-only mode only see the events; all others see every sample in
+ * between as well, without it being stored anywhere.
+ *
+ * Decoders have no access to a raw sample buffer for these chunks.
+ *
+ * @param sess The session to use.
+ * @param start_samplenum The sample number of the first sample in this
+ *                        chunk. Unless it is the first event, the value
+ *                        of the last event sent before holds there. If
+ *                        samples were sent by other means before, with
+ *                        the same unitsize, the last of those holds.
+ * @param end_samplenum The sample number after the last sample in this
+ *                      chunk, up to which no more events occurred. Must be
+ *                      > start_samplenum.
+ * @param samplenums Pointer to the sample number of each event, in
+ *                   ascending order. May be NULL if num_events is 0.
+ * @param values Pointer to the value of each event, arranged like the
+ *               samples passed to srd_session_send(). May be NULL if
+ *               num_events is 0.
+ * @param num_events Number of events in this chunk.
+ * @param unitsize The number of bytes per value.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_send_events(struct srd_session *sess,
+		uint64_t start_samplenum, uint64_t end_samplenum,
+		const uint64_t *samplenums, const uint8_t *values,
+		uint64_t num_events, uint64_t unitsize)
+{
+	int ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (unitsize == 0 || unitsize > INT_MAX / 8) {
+		srd_err("Invalid unitsize %" PRIu64 ".", unitsize);
+		return SRD_ERR_ARG;
+	}
+
+	if (end_samplenum <= start_samplenum) {
+		srd_err("Invalid sample range %" PRIu64 "-%" PRIu64 ".",
+				start_samplenum, end_samplenum);
+		return SRD_ERR_ARG;
+	}
+
+	if (num_events > 0 && (!samplenums || !values)) {
+		srd_err("Invalid events.");
+		return SRD_ERR_ARG;
+	}
+
+	srd_dbg("Calling decode() on all instances with starting sample "
+			"number %" PRIu64 ", %" PRIu64 " events up to sample "
+			"%" PRIu64, start_samplenum, num_events, end_samplenum);
+
+	if (!sess->di_list)
+		return SRD_OK;
+
+	if ((ret = srd_session_flush(sess)) != SRD_OK)
+		return ret;
+
+	if ((ret = session_events(sess, start_samplenum, end_samplenum,
+			samplenums, values, num_events, (int)unitsize)) != SRD_OK)
+		return ret;
+
+	return session_decode(sess, end_samplenum, NULL, 0);
+}
+
+/* Size of the part of a capture file which is mapped at a time. */
+#define FILE_WINDOW_SIZE (64 * 1024 * 1024)
+
+/**
+ * Decode a raw capture file.
+ *
+ * The file holds samples arranged like those passed to srd_session_send().
+ * It is mapped into memory a window at a time, and each window is passed
+ * to the decoders straight from the mapping, without copying it. While
+ * a window is being decoded, the kernel is asked to read ahead the next
+ * one. Files larger than 4 GiB are supported on all platforms with large
+ * file support.
+ *
+ * Sample numbers are those of the samples in the file, so the first one
+ * decoded has sample number offset. An incomplete sample at the end of the
+ * file is ignored.
+ *
+ * If a window was set with srd_session_window_set(), only the samples
+ * needed for it are decoded: from the pre-roll before the window's start,
+ * as found by srd_session_preroll_get(), up to as many samples past its
+ * end, so outputs which overlap the end are completed.
+ *
+ * This is not supported on platforms without mmap(), such as Windows.
+ *
+ * @param sess The session to use.
+ * @param path The path of the capture file. Must not be NULL.
+ * @param offset The number of samples at the start of the file to skip.
+ * @param unitsize The number of bytes per sample.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_send_file(struct srd_session *sess, const char *path,
+		uint64_t offset, uint64_t unitsize)
+{
+#ifdef HAVE_SYS_MMAN_H
+	struct stat st;
+	uint8_t *map;
+	uint64_t num_samples, window, start, end, map_start, map_len, preroll;
+	long page_size;
+	int fd, ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (!path) {
+		srd_err("Invalid capture file path.");
+		return SRD_ERR_ARG;
+	}
+
+	if (unitsize == 0 || unitsize > INT_MAX / 8) {
+		srd_err("Invalid unitsize %" PRIu64 ".", unitsize);
+		return SRD_ERR_ARG;
+	}
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		srd_err("Failed to open capture file %s: %s.", path,
+				g_strerror(errno));
+		return SRD_ERR;
+	}
+	if (fstat(fd, &st) < 0) {
+		srd_err("Failed to stat capture file %s: %s.", path,
+				g_strerror(errno));
+		close(fd);
+		return SRD_ERR;
+	}
+
+	num_samples = (uint64_t)st.st_size / unitsize;
+	if (offset > num_samples) {
+		srd_err("Capture file %s only holds %" PRIu64 " samples.",
+				path, num_samples);
+		close(fd);
+		return SRD_ERR_ARG;
+	}
+
+	if (sess->window_start > 0 || sess->window_end < G_MAXUINT64) {
+		srd_session_preroll_get(sess, &preroll);
+		if (sess->window_start > preroll)
+			offset = MAX(offset, sess->window_start - preroll);
+		/* Outputs which overlap the end need to be completed. */
+		if (sess->window_end < G_MAXUINT64 - preroll)
+			num_samples = MIN(num_samples,
+					MAX(sess->window_end + preroll, offset));
+	}
+
+	srd_dbg("Decoding samples %" PRIu64 " to %" PRIu64 " of capture file "
+			"%s.", offset, num_samples, path);
+
+	ret = SRD_OK;
+	if (!sess->di_list || offset == num_samples) {
+		close(fd);
+		return ret;
+	}
+
+	if ((ret = session_flush_pending(sess)) != SRD_OK) {
+		close(fd);
+		return ret;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	window = MAX(FILE_WINDOW_SIZE / unitsize, 1);
+	for (start = offset; start < num_samples; start = end) {
+		end = MIN(start + window, num_samples);
+
+		/* Mappings have to start on a page boundary. */
+		map_start = start * unitsize - start * unitsize % page_size;
+		map_len = end * unitsize - map_start;
+		map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd,
+				(off_t)map_start);
+		if (map == MAP_FAILED) {
+			srd_err("Failed to mmap() capture file %s: %s.", path,
+					g_strerror(errno));
+			ret = SRD_ERR;
+			break;
+		}
+		posix_madvise(map, map_len, POSIX_MADV_SEQUENTIAL);
+#ifdef POSIX_FADV_WILLNEED
+		if (end < num_samples)
+			posix_fadvise(fd, (off_t)(end * unitsize),
+					(off_t)(MIN(end + window, num_samples) -
+					end) * unitsize, POSIX_FADV_WILLNEED);
+#endif
+
+		ret = session_send(sess, start, end,
+				map + (start * unitsize - map_start),
+				(end - start) * unitsize, (int)unitsize);
+		munmap(map, map_len);
+		if (ret != SRD_OK)
+			break;
+	}
+	close(fd);
+
+	return ret;
+#else
+	(void)sess;
+	(void)path;
+	(void)offset;
+	(void)unitsize;
+
+	srd_err("Capture files can't be mapped on this platform.");
+
+	return SRD_ERR;
+#endif
+}
+
+/**
+ * Attach a session to a shared memory ring buffer.
+ *
+ * Another process, usually the one doing the acquisition, creates the
+ * ring and writes samples into it as described in shm_ring.h.
+ * srd_session_shm_decode() then decodes them straight from the shared
+ * pages, without copying them.
+ *
+ * If the producer gave the samplerate, it is passed on to the session as
+ * with srd_session_metadata_set(). A session is attached to at most one
+ * ring at a time; any previous one is detached.
+ *
+ * @param sess The session to use.
+ * @param name The name of the POSIX shared memory object, as passed to
+ *             shm_open(). Must not be NULL.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_shm_attach(struct srd_session *sess, const char *name)
+{
+#ifdef HAVE_SHM_OPEN
+	struct srd_shm_ring *ring;
+	struct stat st;
+	uint64_t len, unitsize, size, data_offset;
+	int fd;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (!name) {
+		srd_err("Invalid shared memory name.");
+		return SRD_ERR_ARG;
+	}
+
+	srd_session_shm_detach(sess);
+
+	if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+		srd_err("Failed to open shared memory %s: %s.", name,
+				g_strerror(errno));
+		return SRD_ERR;
+	}
+	if (fstat(fd, &st) < 0) {
+		srd_err("Failed to stat shared memory %s: %s.", name,
+				g_strerror(errno));
+		close(fd);
+		return SRD_ERR;
+	}
+	len = st.st_size;
+	if (len < sizeof(struct srd_shm_ring)) {
+		srd_err("Shared memory %s is too small for a ring.", name);
+		close(fd);
+		return SRD_ERR_ARG;
+	}
+	ring = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		srd_err("Failed to mmap() shared memory %s: %s.", name,
+				g_strerror(errno));
+		return SRD_ERR;
+	}
+
+	/* The layout is only published once the magic shows up. */
+	if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) !=
+			SRD_SHM_RING_MAGIC ||
+			ring->version != SRD_SHM_RING_VERSION) {
+		srd_err("Shared memory %s holds no ring.", name);
+		munmap(ring, len);
+		return SRD_ERR_ARG;
+	}
+	unitsize = ring->unitsize;
+	size = ring->size;
+	data_offset = ring->data_offset;
+	if (unitsize == 0 || unitsize > INT_MAX / 8 || size == 0 ||
+			size % unitsize != 0 ||
+			data_offset < sizeof(struct srd_shm_ring) ||
+			data_offset > len || size > len - data_offset) {
+		srd_err("Shared memory %s holds an invalid ring.", name);
+		munmap(ring, len);
+		return SRD_ERR_ARG;
+	}
+
+	sess->shm_ring = ring;
+	sess->shm_len = len;
+	sess->shm_data = (const uint8_t *)ring + data_offset;
+	sess->shm_size = size;
+	sess->shm_unitsize = unitsize;
+	sess->shm_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	srd_dbg("Session %d attached to ring %s of %" PRIu64 " bytes.",
+			sess->session_id, name, size);
+
+	if (ring->samplerate)
+		return srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+				g_variant_new_uint64(ring->samplerate));
+
+	return SRD_OK;
+#else
+	(void)sess;
+	(void)name;
+
+	srd_err("Shared memory is not supported on this platform.");
+
+	return SRD_ERR;
+#endif
+}
+
+/**
+ * Decode all samples the producer has written into the session's shared
+ * memory ring so far.
+ *
+ * The samples are decoded where they are, and only handed back to the
+ * producer once all decoders are done with them. Sample numbers count
+ * from the first sample ever written into the ring. This doesn't wait
+ * for new samples; frontends call it whenever they see fit, for example
+ * from a timer.
+ *
+ * @param sess The session to use. Must be attached to a ring with
+ *             srd_session_shm_attach().
+ * @param closed Pointer to store whether the producer has closed the ring,
+ *               and all its samples have been decoded. Can be NULL.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_shm_decode(struct srd_session *sess, int *closed)
+{
+	struct srd_shm_ring *ring;
+	uint64_t head, tail, pos, len;
+	int ret, done;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (!(ring = sess->shm_ring)) {
+		srd_err("Session %d is not attached to a ring.",
+				sess->session_id);
+		return SRD_ERR_ARG;
+	}
+
+	if ((ret = session_flush_pending(sess)) != SRD_OK)
+		return ret;
+
+	/* Once closed, the head stays where it is. */
+	done = __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	tail = sess->shm_tail;
+	if (head - tail > sess->shm_size || head % sess->shm_unitsize) {
+		srd_err("Ring of session %d has an invalid head %" PRIu64 ".",
+				sess->session_id, head);
+		return SRD_ERR;
+	}
+
+	/* The part up to the end of the data area first, if it wraps. */
+	while (tail != head) {
+		pos = tail % sess->shm_size;
+		len = MIN(head - tail, sess->shm_size - pos);
+		if (sess->di_list && (ret = session_send(sess,
+				tail / sess->shm_unitsize,
+				(tail + len) / sess->shm_unitsize,
+				sess->shm_data + pos, len,
+				sess->shm_unitsize)) != SRD_OK)
+			break;
+		tail += len;
+		sess->shm_tail = tail;
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	}
+
+	if (closed)
+		*closed = done && tail == head;
+
+	return ret;
+}
+
+/**
+ * Detach a session from its shared memory ring.
+ *
+ * The ring itself stays, for the producer to remove with shm_unlink().
+ *
+ * @param sess The session to use.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_shm_detach(struct srd_session *sess)
+{
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (!sess->shm_ring)
+		return SRD_OK;
+
+#ifdef HAVE_SHM_OPEN
+	munmap(sess->shm_ring, sess->shm_len);
+#endif
+	sess->shm_ring = NULL;
+	sess->shm_data = NULL;
+
+	srd_dbg("Session %d detached from its ring.", sess->session_id);
+
+	return SRD_OK;
+}
+
+/**
+ * Set the window of samples the frontend shows.
+ *
+ * This is meant for views zoomed in on part of a long capture, which only
+ * need that part decoded. Outputs which end before start, or begin at or
+ * after end, are not passed to the frontend's callbacks. They are still
+ * passed on to stacked decoders.
+ *
+ * Decoders need to sync to the signal first, so decoding should begin
+ * some time before start, as found by srd_session_preroll_get().
+ * srd_session_send_file() takes care of that by itself.
+ *
+ * @param sess The session to configure.
+ * @param start The first sample of the window.
+ * @param end The sample after the last one of the window. Use 0 and
+ *            UINT64_MAX to show all outputs again.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_window_set(struct srd_session *sess, uint64_t start,
+		uint64_t end)
+{
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (start > end) {
+		srd_err("Invalid window %" PRIu64 "-%" PRIu64 ".", start, end);
+		return SRD_ERR_ARG;
+	}
+
+	session_async_idle(sess);
+	sess->window_start = start;
+	sess->window_end = end;
+
+	srd_dbg("Window of session %d set to %" PRIu64 "-%" PRIu64 ".",
+			sess->session_id, start, end);
+
+	return SRD_OK;
+}
+
+/*
+ * The pre-roll of an instance, plus the longest one of the instances
+ * stacked on top of it, which only start to sync once it outputs data.
+ */
+static uint64_t inst_preroll(const struct srd_decoder_inst *di)
+{
+	PyObject *py_preroll;
+	GSList *l;
+	uint64_t preroll, stacked;
+
+	preroll = 0;
+	if (PyObject_HasAttrString(di->py_inst, "preroll")) {
+		py_preroll = PyObject_GetAttrString(di->py_inst, "preroll");
+		if (py_preroll && PyLong_Check(py_preroll))
+			preroll = PyLong_AsUnsignedLongLong(py_preroll);
+		else
+			srd_warn("Instance %s has an invalid pre-roll.",
+					di->inst_id);
+		Py_XDECREF(py_preroll);
+		if (PyErr_Occurred()) {
+			srd_exception_catch("Instance %s pre-roll: ",
+					di->inst_id);
+			preroll = 0;
+		}
+	}
+
+	/* A decimated instance counts in decimated samples. */
+	if (di->decim)
+		preroll *= di->decim->factor;
+
+	stacked = 0;
+	for (l = di->next_di; l; l = l->next)
+		stacked = MAX(stacked, inst_preroll(l->data));
+
+	return preroll + stacked;
+}
+
+/**
+ * Find the number of samples the session's decoders need to see before
+ * they decode reliably.
+ *
+ * A decoder declares this by setting its 'preroll' attribute to a number
+ * of samples, usually once it knows the samplerate. Decoders which don't,
+ * count as needing none. For decoders stacked on top of another, the
+ * pre-roll of the lower ones is added.
+ *
+ * @param sess The session to query. Should be started, so the decoders
+ *             had a chance to work out their pre-roll.
+ * @param preroll Pointer to store the pre-roll in, in samples.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_preroll_get(struct srd_session *sess,
+		uint64_t *preroll)
+{
+	GSList *d;
+	PyGILState_STATE gstate;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (!preroll) {
+		srd_err("Invalid pre-roll pointer.");
+		return SRD_ERR_ARG;
+	}
+
+	session_async_idle(sess);
+
+	*preroll = 0;
+	gstate = PyGILState_Ensure();
+	for (d = sess->di_list; d; d = d->next)
+		*preroll = MAX(*preroll, inst_preroll(d->data));
+	PyGILState_Release(gstate);
+
+	return SRD_OK;
+}
+
+/**
+ * Set up coalescing of small chunks of logic samples.
+ *
+ * Each chunk passed to srd_session_send() costs a call into every decoder
+ * instance, which is expensive for small chunks. With coalescing, chunks
+ * which follow on from each other are collected in a buffer of the given
+ * size, and only decoded once it is full, once a chunk comes in after the
+ * oldest samples in it have been held back for the given time, or when
+ * srd_session_flush() is called. There is no timer: nothing is decoded
+ * while no chunks come in, however long that is, so frontends should call
+ * srd_session_flush() when they have no more data for now, and at the end
+ * of a capture.
+ *
+ * Any samples still pending are decoded before the new settings apply.
+ *
+ * @param sess The session to configure.
+ * @param bufsize Size of the buffer in bytes, or 0 to turn coalescing off.
+ * @param flush_age Time in microseconds after which the next chunk to come
+ *                  in has the pending samples decoded, or 0 for no limit.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_coalesce_set(struct srd_session *sess,
+		uint64_t bufsize, uint64_t flush_age)
+{
+	uint8_t *pending;
+	int ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (flush_age > G_MAXINT64) {
+		srd_err("Invalid flush age %" PRIu64 ".", flush_age);
+		return SRD_ERR_ARG;
+	}
+
+	if ((ret = session_flush_pending(sess)) != SRD_OK)
+		return ret;
+
+	pending = NULL;
+	if (bufsize > 0 && !(pending = g_try_malloc(bufsize))) {
+		srd_err("Failed to g_malloc() coalescing buffer.");
+		return SRD_ERR_MALLOC;
+	}
+	g_free(sess->pending);
+	sess->pending = pending;
+	sess->coalesce_size = bufsize;
+	sess->coalesce_age = flush_age;
+
+	srd_dbg("Coalescing chunks of session %d up to %" PRIu64 " bytes, "
+			"or %" PRIu64 " us old.", sess->session_id, bufsize,
+			flush_age);
+
+	return SRD_OK;
+}
+
+/**
+ * Set up the glitch filter on a probe.
+ *
+ * The filter removes all pulses shorter than the given number of samples
+ * from the probe's signal, before any decoder gets to see it. Changes of
+ * level which get through keep their sample number. Whether a change in
+ * the last width - 1 samples of a chunk is a glitch is only known once the
+ * next chunk comes in, so those samples are held back, and decoded in
+ * front of the next chunk. Frontends call srd_session_flush() at the end
+ * of a capture to decode them; changes which haven't lasted long enough
+ * by then are dropped. With the filter on, decoders have no access to the
+ * raw sample buffer.
+ *
+ * The filter works on raw and planar input only. Run-length encoded
+ * chunks and events are passed on as they are, with a warning. Samples
+ * held back before them are decoded first.
+ *
+ * Any samples held back are decoded before the new settings apply.
+ *
+ * @param sess The session to configure.
+ * @param probe The probe to filter, or -1 for all probes.
+ * @param width The minimum width of a pulse in samples. 0 or 1 turns the
+ *              filter off, or for a single probe, makes it use the width
+ *              set for all probes.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_glitch_filter_set(struct srd_session *sess,
+		int probe, uint64_t width)
+{
+	uint64_t *glitch_widths;
+	int ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (probe < -1) {
+		srd_err("Invalid probe %d.", probe);
+		return SRD_ERR_ARG;
+	}
+
+	if (width < 2)
+		width = 0;
+
+	session_async_idle(sess);
+	if ((ret = session_held_flush(sess)) != SRD_OK)
+		return ret;
+
+	if (probe == -1) {
+		sess->glitch_width = width;
+	} else {
+		if (probe >= sess->num_glitch_widths) {
+			if (!(glitch_widths = g_try_realloc(sess->glitch_widths,
+					sizeof(uint64_t) * (probe + 1)))) {
+				srd_err("Failed to g_malloc() glitch filter.");
+				return SRD_ERR_MALLOC;
+			}
+			memset(glitch_widths + sess->num_glitch_widths, 0,
+					sizeof(uint64_t) * (probe + 1 -
+					sess->num_glitch_widths));
+			sess->glitch_widths = glitch_widths;
+			sess->num_glitch_widths = probe + 1;
+		}
+		sess->glitch_widths[probe] = width;
+	}
+
+	srd_dbg("Glitch filter of session %d on probe %d set to %" PRIu64
+			" samples.", sess->session_id, probe, width);
+
+	return SRD_OK;
+}
+
+/**
+ * Decode all logic samples held back by coalescing or by the glitch
+ * filter right away. Frontends call this at the end of a capture.
+ *
+ * The samples held back by the glitch filter are decoded as the last ones
+ * of the capture, see srd_session_glitch_filter_set().
+ *
+ * With asynchronous decoding, all queued chunks are decoded first, and
+ * the first error the decode thread ran into is returned.
+ *
+ * @param sess The session to use.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_flush(struct srd_session *sess)
+{
+	int ret, flushed;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	ret = session_flush_pending(sess);
+	flushed = session_held_flush(sess);
+
+	return ret != SRD_OK ? ret : flushed;
+}
+
+/**
+ * Set up decoding in a thread of the session's own.
+ *
+ * srd_session_send() then only copies each chunk into a queue of the given
+ * size and returns, while the session's decode thread takes the chunks
+ * from the queue and decodes them in order. The frontend's thread is not
+ * held up by slow decoders, unless the queue fills up. What happens then
+ * is set by the policy: srd_session_send() can wait for the decode thread
+ * to make room (SRD_ASYNC_BLOCK), throw away the oldest chunks in the
+ * queue (SRD_ASYNC_DROP_OLDEST), or return SRD_ERR_BUSY (SRD_ASYNC_FAIL).
+ *
+ * Output callbacks, as well as the given callback which is called once
+ * each chunk has been decoded, run in the decode thread. The other ways of
+ * sending samples, and all other calls on the session, wait for the queue
+ * to run empty first; srd_session_drain() does only that.
+ *
+ * Callbacks may call into the session, as they may in a synchronous one.
+ * Those calls don't wait for the queue then, as the decode thread can't
+ * wait for itself: they take effect in the middle of the chunk being
+ * decoded. srd_session_send() returns SRD_ERR_BUSY rather than wait for
+ * room in a full queue, and srd_session_async_set() and
+ * srd_session_destroy() can't be called from a callback at all; they
+ * return SRD_ERR_BUSY.
+ *
+ * While any session decodes asynchronously, the library doesn't hold the
+ * Python interpreter lock between calls, but takes it in every call which
+ * needs it. Changing a session's instances or callbacks first waits for
+ * its decode thread to decode all queued chunks. This function must be
+ * called from the thread which called srd_init().
+ *
+ * @param sess The session to configure.
+ * @param bufsize Size of the queue in bytes, or 0 to decode all queued
+ *                chunks and go back to decoding in the caller's thread.
+ * @param policy What to do when the queue is full: SRD_ASYNC_BLOCK,
+ *               SRD_ASYNC_DROP_OLDEST or SRD_ASYNC_FAIL.
+ * @param cb The function to call once a chunk has been decoded, with the
+ *           result of decoding it. Can be NULL.
+ * @param cb_data Private data for the callback function. Can be NULL.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_async_set(struct srd_session *sess, uint64_t bufsize,
+		int policy, srd_session_decoded_callback_t cb, void *cb_data)
+{
+	GError *error;
+	int ret;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (policy != SRD_ASYNC_BLOCK && policy != SRD_ASYNC_DROP_OLDEST &&
+			policy != SRD_ASYNC_FAIL) {
+		srd_err("Invalid queue policy %d.", policy);
+		return SRD_ERR_ARG;
+	}
+
+	if (session_async_self(sess)) {
+		srd_err("Session %d can't stop its decode thread from a "
+				"callback.", sess->session_id);
+		return SRD_ERR_BUSY;
+	}
+
+	/* The thread runs with the old settings until it is done. */
+	ret = session_async_stop(sess);
+	if (bufsize == 0) {
+		srd_dbg("Session %d decodes synchronously.", sess->session_id);
+		return ret;
+	}
+
+	g_mutex_init(&sess->async_mutex);
+	g_cond_init(&sess->async_cond);
+	g_queue_init(&sess->async_queue);
+	sess->async_size = bufsize;
+	sess->async_queued = 0;
+	sess->async_policy = policy;
+	sess->async_busy = sess->async_stop = FALSE;
+	sess->async_ret = SRD_OK;
+	sess->async_dropped = 0;
+	sess->async_cb = cb;
+	sess->async_cb_data = cb_data;
+
+	if (async_sessions++ == 0)
+		async_tstate = PyEval_SaveThread();
+
+	error = NULL;
+	if (!(sess->async_thread = g_thread_try_new("srd-decode",
+			session_async_thread, sess, &error))) {
+		srd_err("Failed to start decode thread: %s.", error->message);
+		g_error_free(error);
+		g_mutex_clear(&sess->async_mutex);
+		g_cond_clear(&sess->async_cond);
+		if (--async_sessions == 0) {
+			PyEval_RestoreThread(async_tstate);
+			async_tstate = NULL;
+		}
+		return SRD_ERR;
+	}
+
+	srd_dbg("Session %d decodes in its own thread, queueing up to "
+			"%" PRIu64 " bytes.", sess->session_id, bufsize);
+
+	return ret;
+}
+
+/**
+ * Wait until all chunks queued for asynchronous decoding are decoded.
+ *
+ * Samples held back by coalescing stay pending, see srd_session_flush().
+ *
+ * @param sess The session to use.
+ *
+ * @return SRD_OK upon success, or the first error the decode thread ran
+ *         into since it was last returned.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_drain(struct srd_session *sess)
+{
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	return session_async_wait(sess);
+}
+
+/**
+ * Destroy a decoding session.
+ *
+ * All decoder instances and output callbacks are properly released.
+ *
+ * @param sess The session to be destroyed.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_session_destroy(struct srd_session *sess)
+{
+	PyGILState_STATE gstate;
+	int session_id;
+
+	if (!sess) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	if (session_async_self(sess)) {
+		srd_err("Session %d can't be destroyed from a callback.",
+				sess->session_id);
+		return SRD_ERR_BUSY;
+	}
+
+	session_id = sess->session_id;
+	session_async_stop(sess);
+	srd_session_shm_detach(sess);
+	/* The edge index holds Python objects, too. */
+	gstate = PyGILState_Ensure();
+	if (sess->di_list)
+		srd_inst_free_all(sess, NULL);
+	srd_chunk_edges_clear(&sess->chunk);
+	PyGILState_Release(gstate);
+	if (sess->callbacks)
+		g_slist_free_full(sess->callbacks, g_free);
+	g_free(sess->chunk.planes);
+	g_free(sess->chunk.lane_masks);
+	g_free(sess->chunk.edges);
+	g_free(sess->chunk.prev_bits);
+	g_free(sess->chunk.plane_buf);
+	g_free(sess->chunk.run_starts);
+	g_free(sess->pending);
+	g_free(sess->glitch_widths);
+	g_free(sess->held);
+	g_free(sess->event_value);
+	g_free(sess->event_runs);
+	sessions = g_slist_remove(sessions, sess);
+	g_free(sess);
+
+	srd_dbg("Destroyed session %d.", session_id);
+
+	return SRD_OK;
+}
+
+/**
+ * Register/add a decoder output callback function.
+ *
+ * The function will be called when a protocol decoder sends output back
+ * to the PD controller (except for Python objects, which only go up the
+ * stack).
+ *
+ * @param sess The output session in which to register the callback.
+ * @param output_type The output type this callback will receive. Only one
+ *                    callback per output type can be registered.
+ * @param cb The function to call. Must not be NULL.
+ * @param cb_data Private data for the callback function. Can be NULL.
+ *
+ * @since 0.3.0
+ */
+SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
+		int output_type, srd_pd_output_callback_t cb, void *cb_data)
+{
+	struct srd_pd_callback *pd_cb;
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		return SRD_ERR_ARG;
+	}
+
+	srd_dbg("Registering new callback for output type %d.", output_type);
+
+	/* The decode thread looks the callbacks up. */
+	session_async_idle(sess);
 
 	if (!(pd_cb = g_try_malloc(sizeof(struct srd_pd_callback)))) {
 		srd_err("Failed to g_malloc() struct srd_pd_callback.");
@@ -0,0 +1,153 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef LIBSIGROKDECODE_SHM_RING_H
+#define LIBSIGROKDECODE_SHM_RING_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @file
+ *
+ * Shared memory ring buffer, through which another process on the same
+ * machine can pass logic samples to a session, see
+ * srd_session_shm_attach().
+ *
+ * This header doesn't need the rest of libsigrokdecode, so acquisition
+ * programs can include it on its own. The producer sets the ring up:
+ *
+ *  1. Create a POSIX shared memory object with shm_open(), make it
+ *     data_offset + size bytes long with ftruncate(), and mmap() it.
+ *  2. Call srd_shm_ring_init() on the start of the mapping.
+ *  3. Pass samples in with srd_shm_ring_write() as they are captured,
+ *     retrying whatever didn't fit once the decoder has caught up.
+ *  4. Call srd_shm_ring_close() at the end of the capture.
+ *
+ * The ring has a single producer and a single consumer, and no locks:
+ * head and tail count all bytes ever written and decoded, so the ring
+ * is empty when they are equal, and full when they are size bytes
+ * apart. Only the producer writes head, only the consumer writes tail,
+ * and each of them publishes the data or room it is done with by storing
+ * its index with release semantics, after loading the other's index with
+ * acquire semantics. Both indices are native 64-bit integers, so the
+ * ring can't be shared between machines with a different byte order.
+ */
+
+/** "SRDR", in the magic field of every ring. */
+#define SRD_SHM_RING_MAGIC   0x52445253
+/** Version of the layout below. */
+#define SRD_SHM_RING_VERSION 1
+
+/** Start of a shared memory ring; the samples follow at data_offset. */
+struct srd_shm_ring {
+	/** SRD_SHM_RING_MAGIC. */
+	uint32_t magic;
+	/** SRD_SHM_RING_VERSION. */
+	uint32_t version;
+	/** Number of bytes per sample, arranged as for srd_session_send(). */
+	uint64_t unitsize;
+	/** Size of the data area in bytes, a multiple of unitsize. */
+	uint64_t size;
+	/** Offset of the data area from the start of the ring. */
+	uint64_t data_offset;
+	/** The samplerate of the capture, or 0 if unknown. */
+	uint64_t samplerate;
+	uint8_t reserved[24];
+
+	/* Written by the producer only, in a cache line of their own. */
+	/** Number of bytes written since the ring was set up. */
+	uint64_t head;
+	/** Non-zero once the producer has written its last sample. */
+	uint32_t closed;
+	uint8_t producer_pad[52];
+
+	/* Written by the consumer only. */
+	/** Number of bytes decoded since the ring was set up. */
+	uint64_t tail;
+	uint8_t consumer_pad[56];
+};
+
+/**
+ * Set up a ring in freshly mapped shared memory.
+ *
+ * @param ring The start of the mapping.
+ * @param data_offset Offset of the data area, at least
+ *                    sizeof(struct srd_shm_ring). Use the page size, so
+ *                    the samples are page aligned.
+ * @param size Size of the data area in bytes, a multiple of unitsize.
+ * @param unitsize The number of bytes per sample.
+ * @param samplerate The samplerate of the capture, or 0 if unknown.
+ */
+static inline void srd_shm_ring_init(struct srd_shm_ring *ring,
+		uint64_t data_offset, uint64_t size, uint64_t unitsize,
+		uint64_t samplerate)
+{
+	memset(ring, 0, sizeof(struct srd_shm_ring));
+	ring->version = SRD_SHM_RING_VERSION;
+	ring->unitsize = unitsize;
+	ring->size = size;
+	ring->data_offset = data_offset;
+	ring->samplerate = samplerate;
+	/* A consumer only accepts the ring once the magic shows up. */
+	__atomic_store_n(&ring->magic, SRD_SHM_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copy samples into the ring, as many whole samples as there is room for.
+ *
+ * @param ring The ring to write to.
+ * @param buf The samples.
+ * @param len Length of buf in bytes.
+ *
+ * @return The number of bytes written, which may be 0 if the ring is full.
+ */
+static inline uint64_t srd_shm_ring_write(struct srd_shm_ring *ring,
+		const uint8_t *buf, uint64_t len)
+{
+	uint8_t *data;
+	uint64_t head, room, pos, part;
+
+	data = (uint8_t *)ring + ring->data_offset;
+	head = ring->head;
+	room = ring->size - (head - __atomic_load_n(&ring->tail,
+			__ATOMIC_ACQUIRE));
+	if (len > room)
+		len = room;
+	len -= len % ring->unitsize;
+
+	pos = head % ring->size;
+	part = ring->size - pos < len ? ring->size - pos : len;
+	memcpy(data + pos, buf, part);
+	memcpy(data, buf + part, len - part);
+	__atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+
+	return len;
+}
+
+/**
+ * Mark the end of the capture, once all samples are written.
+ *
+ * @param ring The ring to close.
+ */
+static inline void srd_shm_ring_close(struct srd_shm_ring *ring)
+{
+	__atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -142,6 +142,10 @@ SRD_API int srd_init(const char *path)
 
 	/* Initialize the Python interpreter. */
 	Py_Initialize();
+#if PY_VERSION_HEX < 0x03070000
+	/* Set up the interpreter lock, for sessions decoding in a thread. */
+	PyEval_InitThreads();
+#endif
 
 	/* Installed decoders. */
 	if ((ret = srd_decoder_searchpath_add(DECODERS_DIR)) != SRD_OK) {
@@ -197,6 +201,8 @@ SRD_API int srd_exit(void)
 	g_slist_free(pd_list);
 	pd_list = NULL;
 
+	srd_packet_cleanup();
+
 	/* Py_Finalize() returns void, any finalization errors are ignored. */
 	Py_Finalize();
 
@@ -0,0 +1,220 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Microbenchmark for the srd_logic sample iterator.
+ *
+ * Feeds a capture through a PD which does nothing but iterate over its
+ * samples, and reports the time and the number of Python heap allocations
+ * per million samples, both with every sample handed to the PD and in
+ * edges-only mode.
+ *
+ * Build with 'make bench_logic' in the tests directory.
+ */
+
+#include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_SAMPLES (8 * 1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+/* The sample value changes every this many samples. */
+#define RUN_LENGTH 1000
+
+static const char *sink_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'bench_sink'\n"
+	"    name = 'Sink'\n"
+	"    longname = 'Benchmark sink'\n"
+	"    desc = 'Iterates over all samples, and does nothing.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = []\n"
+	"    probes = [{'id': 'd%d' % i, 'name': 'D%d' % i, 'desc': ''}\n"
+	"              for i in range(8)]\n"
+	"    options = {'edges': ['Only iterate over edges', 0]}\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.edges_only = self.options['edges'] == 1\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        for (self.samplenum, pins) in data:\n"
+	"            pass\n";
+
+static uint64_t num_allocs;
+static PyMemAllocatorEx orig_mem, orig_obj;
+
+static void *count_malloc(void *ctx, size_t size)
+{
+	PyMemAllocatorEx *orig = ctx;
+
+	num_allocs++;
+	return orig->malloc(orig->ctx, size);
+}
+
+static void *count_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+	PyMemAllocatorEx *orig = ctx;
+
+	num_allocs++;
+	return orig->calloc(orig->ctx, nelem, elsize);
+}
+
+static void *count_realloc(void *ctx, void *ptr, size_t new_size)
+{
+	PyMemAllocatorEx *orig = ctx;
+
+	num_allocs++;
+	return orig->realloc(orig->ctx, ptr, new_size);
+}
+
+static void count_free(void *ctx, void *ptr)
+{
+	PyMemAllocatorEx *orig = ctx;
+
+	orig->free(orig->ctx, ptr);
+}
+
+static void hook_allocator(PyMemAllocatorDomain domain,
+		PyMemAllocatorEx *orig)
+{
+	PyMemAllocatorEx alloc;
+
+	PyMem_GetAllocator(domain, orig);
+	alloc.ctx = orig;
+	alloc.malloc = count_malloc;
+	alloc.calloc = count_calloc;
+	alloc.realloc = count_realloc;
+	alloc.free = count_free;
+	PyMem_SetAllocator(domain, &alloc);
+}
+
+static int write_pd(const char *dir, gboolean remove)
+{
+	char *pd_dir, *pd_file;
+	int ret;
+
+	pd_dir = g_build_filename(dir, "bench_sink", NULL);
+	pd_file = g_build_filename(pd_dir, "__init__.py", NULL);
+	if (remove) {
+		g_remove(pd_file);
+		g_rmdir(pd_dir);
+		g_rmdir(dir);
+		ret = TRUE;
+	} else {
+		ret = g_mkdir(pd_dir, 0700) == 0 &&
+			g_file_set_contents(pd_file, sink_pd, -1, NULL);
+	}
+	g_free(pd_file);
+	g_free(pd_dir);
+
+	return ret ? 0 : -1;
+}
+
+static int run(const uint8_t *buf, int edges)
+{
+	struct srd_session *sess;
+	struct srd_decoder_inst *di;
+	GHashTable *options;
+	gint64 start, end;
+	uint64_t allocs, i;
+	int ret;
+
+	srd_session_new(&sess);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "edges",
+			g_variant_ref_sink(g_variant_new_int64(edges)));
+	di = srd_inst_new(sess, "bench_sink", options);
+	g_hash_table_destroy(options);
+	if (!di || srd_session_start(sess) != SRD_OK) {
+		fprintf(stderr, "Failed to start session.\n");
+		return -1;
+	}
+
+	ret = 0;
+	allocs = num_allocs;
+	start = g_get_monotonic_time();
+	for (i = 0; i < NUM_SAMPLES; i += CHUNK_SIZE) {
+		if (srd_session_send(sess, i, i + CHUNK_SIZE, buf + i,
+				CHUNK_SIZE, 1) != SRD_OK) {
+			fprintf(stderr, "srd_session_send() failed.\n");
+			ret = -1;
+			break;
+		}
+	}
+	end = g_get_monotonic_time();
+	allocs = num_allocs - allocs;
+
+	printf("%-12s %10.1f ns/sample %12.0f allocations/Msample\n",
+		edges ? "edges only" : "all samples",
+		(end - start) * 1000.0 / NUM_SAMPLES,
+		allocs * 1000000.0 / NUM_SAMPLES);
+
+	srd_session_destroy(sess);
+
+	return ret;
+}
+
+int main(void)
+{
+	uint8_t *buf;
+	char *dir;
+	uint64_t i;
+	int ret;
+
+	if (!(dir = g_dir_make_tmp("srd-bench-XXXXXX", NULL)) ||
+			write_pd(dir, FALSE) != 0) {
+		fprintf(stderr, "Failed to set up benchmark PD.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!(buf = g_try_malloc(NUM_SAMPLES))) {
+		fprintf(stderr, "Failed to allocate sample buffer.\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < NUM_SAMPLES; i++)
+		buf[i] = (i / RUN_LENGTH) & 0xff;
+
+	/* Keep the temporary PD directory free of bytecode files. */
+	g_setenv("PYTHONDONTWRITEBYTECODE", "1", TRUE);
+	srd_log_loglevel_set(SRD_LOG_ERR);
+	if (srd_init(dir) != SRD_OK || srd_decoder_load("bench_sink") != SRD_OK) {
+		fprintf(stderr, "Failed to load benchmark PD.\n");
+		return EXIT_FAILURE;
+	}
+
+	hook_allocator(PYMEM_DOMAIN_MEM, &orig_mem);
+	hook_allocator(PYMEM_DOMAIN_OBJ, &orig_obj);
+
+	ret = run(buf, 0) == 0 && run(buf, 1) == 0;
+
+	PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &orig_mem);
+	PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &orig_obj);
+	srd_exit();
+	write_pd(dir, TRUE);
+	g_free(buf);
+	g_free(dir);
+
+	return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
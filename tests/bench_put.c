@@ -0,0 +1,176 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Microbenchmark for Decoder.put().
+ *
+ * Runs a PD which does nothing but put() annotations, in the last of a
+ * growing number of sessions, each holding a growing number of instances,
+ * and reports the time per put(). It should not depend on how many
+ * sessions and instances there are.
+ *
+ * Build with 'make bench_put' in the tests directory.
+ */
+
+#include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_CHUNKS 100
+#define PUTS_PER_CHUNK 1000
+
+static const char *put_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'bench_put'\n"
+	"    name = 'Put'\n"
+	"    longname = 'Benchmark put'\n"
+	"    desc = 'Puts annotations, and does nothing else.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['bench_put']\n"
+	"    probes = [{'id': 'd0', 'name': 'D0', 'desc': ''}]\n"
+	"    annotations = [['put', 'Put']]\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        for i in range(%d):\n"
+	"            self.put(ss, es, self.out_ann, [0, ['put']])\n";
+
+static void ann_cb(struct srd_proto_data *pdata, void *cb_data)
+{
+	(void)pdata;
+	(*(uint64_t *)cb_data)++;
+}
+
+static int write_pd(const char *dir, gboolean remove)
+{
+	char *pd_dir, *pd_file, *code;
+	int ret;
+
+	pd_dir = g_build_filename(dir, "bench_put", NULL);
+	pd_file = g_build_filename(pd_dir, "__init__.py", NULL);
+	if (remove) {
+		g_remove(pd_file);
+		g_rmdir(pd_dir);
+		g_rmdir(dir);
+		ret = TRUE;
+	} else {
+		code = g_strdup_printf(put_pd, PUTS_PER_CHUNK);
+		ret = g_mkdir(pd_dir, 0700) == 0 &&
+			g_file_set_contents(pd_file, code, -1, NULL);
+		g_free(code);
+	}
+	g_free(pd_file);
+	g_free(pd_dir);
+
+	return ret ? 0 : -1;
+}
+
+static int run(int num_sessions, int num_insts)
+{
+	struct srd_session **sess;
+	uint8_t buf[64];
+	gint64 start, end;
+	uint64_t num_anns;
+	int ret, i, j;
+
+	sess = g_malloc(sizeof(struct srd_session *) * num_sessions);
+	for (i = 0; i < num_sessions; i++) {
+		srd_session_new(&sess[i]);
+		for (j = 0; j < num_insts; j++) {
+			if (!srd_inst_new(sess[i], "bench_put", NULL)) {
+				fprintf(stderr, "Failed to create instance.\n");
+				return -1;
+			}
+		}
+		if (srd_session_start(sess[i]) != SRD_OK) {
+			fprintf(stderr, "Failed to start session.\n");
+			return -1;
+		}
+	}
+
+	/* The last session is the one furthest from the start of the list. */
+	num_anns = 0;
+	srd_pd_output_callback_add(sess[num_sessions - 1], SRD_OUTPUT_ANN,
+			ann_cb, &num_anns);
+	memset(buf, 0, sizeof(buf));
+
+	ret = 0;
+	start = g_get_monotonic_time();
+	for (i = 0; i < NUM_CHUNKS; i++) {
+		if (srd_session_send(sess[num_sessions - 1], i * sizeof(buf),
+				(i + 1) * sizeof(buf), buf, sizeof(buf),
+				1) != SRD_OK) {
+			fprintf(stderr, "srd_session_send() failed.\n");
+			ret = -1;
+			break;
+		}
+	}
+	end = g_get_monotonic_time();
+
+	printf("%5d sessions %4d instances %8.1f ns/put\n", num_sessions,
+		num_insts, (end - start) * 1000.0 / MAX(num_anns, 1));
+
+	for (i = 0; i < num_sessions; i++)
+		srd_session_destroy(sess[i]);
+	g_free(sess);
+
+	return ret;
+}
+
+int main(void)
+{
+	static const int num_sessions[] = { 1, 16, 256 };
+	static const int num_insts[] = { 1, 16 };
+	char *dir;
+	unsigned int i, j;
+	int ret;
+
+	if (!(dir = g_dir_make_tmp("srd-bench-XXXXXX", NULL)) ||
+			write_pd(dir, FALSE) != 0) {
+		fprintf(stderr, "Failed to set up benchmark PD.\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Keep the temporary PD directory free of bytecode files. */
+	g_setenv("PYTHONDONTWRITEBYTECODE", "1", TRUE);
+	srd_log_loglevel_set(SRD_LOG_ERR);
+	if (srd_init(dir) != SRD_OK || srd_decoder_load("bench_put") != SRD_OK) {
+		fprintf(stderr, "Failed to load benchmark PD.\n");
+		return EXIT_FAILURE;
+	}
+
+	ret = TRUE;
+	for (i = 0; ret && i < G_N_ELEMENTS(num_sessions); i++) {
+		for (j = 0; ret && j < G_N_ELEMENTS(num_insts); j++)
+			ret = run(num_sessions[i], num_insts[j]) == 0;
+	}
+
+	srd_exit();
+	write_pd(dir, TRUE);
+	g_free(dir);
+
+	return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
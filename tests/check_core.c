@@ -95,6 +95,56 @@ START_TEST(test_init_exit_3)
 }
 END_TEST
 
+/*
+ * Check whether the OUTPUT_PYTHON packet types unpack like the lists they
+ * replace, only take their own decoder's commands, and survive being
+ * reused from their free list across srd_init()/srd_exit().
+ */
+START_TEST(test_packet)
+{
+	int ret, i;
+	const char *code =
+		"import sigrokdecode as srd\n"
+		"for i in range(100):\n"
+		"    p = srd.I2CPacket('ADDRESS WRITE', 0x50)\n"
+		"    cmd, databyte = p\n"
+		"    assert (cmd, databyte) == ('ADDRESS WRITE', 0x50)\n"
+		"    assert p.code == srd.CMD_ADDRESS_WRITE\n"
+		"    assert p.cmd == 'ADDRESS WRITE' and p.databyte == 0x50\n"
+		"    p = srd.UARTPacket(srd.CMD_DATA, 1, 0x41)\n"
+		"    assert list(p) == ['DATA', 1, 0x41] and p.data == 0x41\n"
+		"    p = srd.SPIPacket('CS-CHANGE', 1, 0)\n"
+		"    assert p.code == srd.CMD_CS_CHANGE and p[2] == p.miso == 0\n"
+		"for args in (('FOO', None), (-1, None), ('STOP',)):\n"
+		"    try:\n"
+		"        srd.I2CPacket(*args)\n"
+		"        assert False\n"
+		"    except (TypeError, ValueError):\n"
+		"        pass\n"
+		"for t, args in ((srd.I2CPacket, ('CS-CHANGE', 1)),\n"
+		"        (srd.I2CPacket, ('DATA', 1)),\n"
+		"        (srd.SPIPacket, ('STARTBIT', 0, 1)),\n"
+		"        (srd.SPIPacket, ('ACK', 0, 1)),\n"
+		"        (srd.UARTPacket, ('START', 0, 1)),\n"
+		"        (srd.UARTPacket, (srd.CMD_CS_CHANGE, 0, 1))):\n"
+		"    try:\n"
+		"        t(*args)\n"
+		"        assert False\n"
+		"    except ValueError:\n"
+		"        pass\n"
+		"srd.UARTPacket('INVALID STOPBIT', 0, 1)\n"
+		"srd.I2CPacket('DATA WRITE', 1)\n";
+
+	for (i = 0; i < 2; i++) {
+		ret = srd_init(NULL);
+		fail_unless(ret == SRD_OK, "srd_init() failed: %d.", ret);
+		ret = PyRun_SimpleString(code);
+		fail_unless(ret == 0, "Packet checks failed.");
+		srd_exit();
+	}
+}
+END_TEST
+
 Suite *suite_core(void)
 {
 	Suite *s;
@@ -109,5 +159,10 @@ Suite *suite_core(void)
 	tcase_add_test(tc, test_init_exit_3);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("packet");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_packet);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -20,7 +20,12 @@
 
 #include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
+#include "lib.h"
+
+/* Prime, so chunks split runs and clock cycles at varying points. */
+#define EDGES_CHUNK_SAMPLES 97
 
 static void setup(void)
 {
@@ -311,6 +316,276 @@ START_TEST(test_doc_get_null)
 }
 END_TEST
 
+/* A capture of up to 16 probes, built up sample by sample. */
+struct capture {
+	uint16_t *samples;
+	uint64_t len;
+};
+
+/* Hold the probes at 'value' for 'count' samples. */
+static void cap_hold(struct capture *cap, unsigned int value, uint64_t count)
+{
+	cap->samples = g_realloc(cap->samples,
+			(cap->len + count) * sizeof(uint16_t));
+	while (count--)
+		cap->samples[cap->len++] = value;
+}
+
+/* One clock cycle with the data in 'value': low half, then high half. */
+static void cap_clock(struct capture *cap, unsigned int value, int clk)
+{
+	cap_hold(cap, value, 5);
+	cap_hold(cap, value | (1 << clk), 5);
+}
+
+/* miso, mosi, sck, cs: mode 0, MSB first, 8-bit words. */
+static void gen_spi(struct capture *cap, GRand *rand)
+{
+	unsigned int miso, mosi, value;
+	int i, bit;
+
+	cap_hold(cap, 1 << 3, 20);
+	for (i = 0; i < 20; i++) {
+		miso = g_rand_int_range(rand, 0, 256);
+		mosi = g_rand_int_range(rand, 0, 256);
+		for (bit = 7; bit >= 0; bit--) {
+			value = ((miso >> bit) & 1) | (((mosi >> bit) & 1) << 1);
+			cap_clock(cap, value, 2);
+		}
+		cap_hold(cap, 0, 3);
+		cap_hold(cap, 1 << 3, 13);
+	}
+}
+
+/* scl, sda: address plus two data bytes per transfer. */
+static void gen_i2c(struct capture *cap, GRand *rand)
+{
+	unsigned int byte, sda;
+	int i, j, bit;
+
+	cap_hold(cap, 3, 20);
+	for (i = 0; i < 8; i++) {
+		/* START: SDA falls while SCL is high. */
+		cap_hold(cap, 1, 5);
+		cap_hold(cap, 0, 5);
+		for (j = 0; j < 3; j++) {
+			byte = g_rand_int_range(rand, 0, 256);
+			for (bit = 8; bit >= 0; bit--) {
+				/* The ninth bit is the ACK, alternating with NACK. */
+				sda = bit ? (byte >> (bit - 1)) & 1 : j & 1;
+				cap_clock(cap, sda << 1, 0);
+			}
+			cap_hold(cap, 0, 5);
+		}
+		/* STOP: SDA rises while SCL is high. */
+		cap_hold(cap, 1, 5);
+		cap_hold(cap, 3, 15);
+	}
+}
+
+/* tdi, tdo, tck, tms: shift DR and IR in turn, from Run-Test/Idle. */
+static void gen_jtag(struct capture *cap, GRand *rand)
+{
+	/* Select-DR-Scan, Capture-DR, Shift-DR; the same via Select-IR-Scan. */
+	static const char *to_shift[2] = { "100", "1100" };
+	unsigned int tdi, tdo;
+	const char *tms;
+	int i, bit;
+
+	/* Test-Logic-Reset, then Run-Test/Idle. */
+	for (i = 0; i < 5; i++)
+		cap_clock(cap, 1 << 3, 2);
+	cap_clock(cap, 0, 2);
+	for (i = 0; i < 10; i++) {
+		for (tms = to_shift[i & 1]; *tms; tms++)
+			cap_clock(cap, (*tms - '0') << 3, 2);
+		tdi = g_rand_int_range(rand, 0, 256);
+		tdo = g_rand_int_range(rand, 0, 256);
+		/* The last bit goes to Exit1, then Update and Run-Test/Idle. */
+		for (bit = 0; bit < 8; bit++)
+			cap_clock(cap, ((tdi >> bit) & 1) | (((tdo >> bit) & 1) << 1)
+					| ((bit == 7) << 3), 2);
+		cap_clock(cap, 1 << 3, 2);
+		cap_clock(cap, 0, 2);
+	}
+}
+
+/* lframe, lclk, lad0-3: memory read cycles. */
+static void gen_lpc(struct capture *cap, GRand *rand)
+{
+	uint32_t addr;
+	int i, n;
+
+	/* The optional probes (bits 6-12) are held high. */
+#define LPC(lframe, lad) (0x1fc0 | (lframe) | ((lad) << 2))
+	for (n = 0; n < 3; n++)
+		cap_clock(cap, LPC(1, 0xf), 1);
+	for (i = 0; i < 10; i++) {
+		cap_clock(cap, LPC(0, 0), 1);
+		cap_clock(cap, LPC(1, 0), 1);
+		cap_clock(cap, LPC(1, 0x4), 1);
+		addr = g_rand_int(rand);
+		for (n = 7; n >= 0; n--)
+			cap_clock(cap, LPC(1, (addr >> (n * 4)) & 0xf), 1);
+		cap_clock(cap, LPC(1, 0xf), 1);
+		cap_clock(cap, LPC(1, 0xf), 1);
+		cap_clock(cap, LPC(1, 0), 1);
+		cap_clock(cap, LPC(1, g_rand_int_range(rand, 0, 16)), 1);
+		cap_clock(cap, LPC(1, g_rand_int_range(rand, 0, 16)), 1);
+		cap_clock(cap, LPC(1, 0xf), 1);
+		cap_clock(cap, LPC(1, 0xf), 1);
+		cap_clock(cap, LPC(1, 0xf), 1);
+	}
+#undef LPC
+}
+
+/* clk, d0-d7. */
+static void gen_parallel(struct capture *cap, GRand *rand)
+{
+	int i;
+
+	for (i = 0; i < 100; i++)
+		cap_clock(cap, g_rand_int_range(rand, 0, 256) << 1, 0);
+	cap_hold(cap, 0, 10);
+}
+
+/* data, at 100 samples per second: two minutes of 12:37, 16.10.26. */
+static void gen_dcf77(struct capture *cap, GRand *rand)
+{
+	static const struct {
+		int first, width, value;
+	} fields[] = {
+		{ 21, 7, 0x37 }, { 29, 6, 0x12 }, { 36, 6, 0x16 },
+		{ 42, 3, 5 }, { 45, 5, 0x10 }, { 50, 8, 0x26 },
+	};
+	uint64_t bits;
+	unsigned int f;
+	int i, sec;
+
+	(void)rand;
+	bits = 1ULL << 20;
+	for (f = 0; f < G_N_ELEMENTS(fields); f++)
+		bits |= (uint64_t)fields[f].value << fields[f].first;
+	cap_hold(cap, 0, 200);
+	for (i = 0; i < 2; i++) {
+		for (sec = 0; sec < 59; sec++) {
+			/* 100ms high is a 0, 200ms high is a 1. */
+			cap_hold(cap, 1, (bits >> sec) & 1 ? 20 : 10);
+			cap_hold(cap, 0, (bits >> sec) & 1 ? 80 : 90);
+		}
+		/* No edge for second 59 marks the next minute. */
+		cap_hold(cap, 0, 100);
+	}
+	cap_hold(cap, 1, 10);
+	cap_hold(cap, 0, 90);
+}
+
+/* clk, data, load, ldac: 11-bit frames, each latched and loaded. */
+static void gen_tlc5620(struct capture *cap, GRand *rand)
+{
+	unsigned int frame;
+	int i, bit;
+
+	cap_hold(cap, 0xc, 20);
+	for (i = 0; i < 12; i++) {
+		frame = g_rand_int_range(rand, 0, 1 << 11);
+		/* DATA is shifted in on the falling CLK edge, MSB first. */
+		for (bit = 10; bit >= 0; bit--)
+			cap_clock(cap, 0xc | (((frame >> bit) & 1) << 1), 0);
+		cap_hold(cap, 0xc, 5);
+		cap_hold(cap, 0x8, 5);
+		cap_hold(cap, 0xc, 5);
+		cap_hold(cap, 0x4, 5);
+		cap_hold(cap, 0xc, 10);
+	}
+}
+
+static const struct {
+	const char *id;
+	void (*gen)(struct capture *cap, GRand *rand);
+	uint64_t samplerate;
+	uint64_t unitsize;
+} edges_pds[] = {
+	{ "spi", gen_spi, 1000000, 1 },
+	{ "i2c", gen_i2c, 1000000, 1 },
+	{ "jtag", gen_jtag, 1000000, 1 },
+	{ "lpc", gen_lpc, 1000000, 2 },
+	{ "parallel", gen_parallel, 1000000, 2 },
+	{ "dcf77", gen_dcf77, 100, 1 },
+	{ "tlc5620", gen_tlc5620, 1000000, 1 },
+};
+
+/* Decode the capture in chunks, with or without edges_only. */
+static void edges_decode(int pd, const struct capture *cap,
+		gboolean edges_only, GString *anns)
+{
+	struct srd_session *sess;
+	struct srd_decoder_inst *di;
+	uint64_t unitsize, i, n;
+	uint8_t *buf;
+	int ret;
+
+	sess = srdtest_session_new(edges_pds[pd].id, NULL, anns);
+	di = srd_inst_find_by_id(sess, edges_pds[pd].id);
+	if (!edges_only)
+		PyObject_SetAttrString(di->py_inst, "edges_only", Py_False);
+	srdtest_session_start(sess, edges_pds[pd].samplerate);
+	fail_unless(di->edges_only == edges_only,
+			"%s: edges_only is %d.", edges_pds[pd].id, di->edges_only);
+
+	unitsize = edges_pds[pd].unitsize;
+	buf = g_malloc(cap->len * unitsize);
+	for (i = 0; i < cap->len; i++) {
+		buf[i * unitsize] = cap->samples[i] & 0xff;
+		if (unitsize > 1)
+			buf[i * unitsize + 1] = cap->samples[i] >> 8;
+	}
+	for (i = 0; i < cap->len; i += n) {
+		n = MIN(cap->len - i, EDGES_CHUNK_SAMPLES);
+		ret = srd_session_send(sess, i, i + n, buf + i * unitsize,
+				n * unitsize, unitsize);
+		fail_unless(ret == SRD_OK, "%s: srd_session_send() failed: %d.",
+				edges_pds[pd].id, ret);
+	}
+	g_free(buf);
+	srd_session_destroy(sess);
+}
+
+/*
+ * Check whether the PDs which set edges_only decode a capture the same
+ * with and without it.
+ * If any annotation differs (or none are put) this test will fail.
+ */
+START_TEST(test_edges_only)
+{
+	struct capture cap;
+	GString *edges, *all;
+	GRand *rand;
+
+	cap.samples = NULL;
+	cap.len = 0;
+	rand = g_rand_new_with_seed(_i + 1);
+	edges_pds[_i].gen(&cap, rand);
+	g_rand_free(rand);
+
+	edges = g_string_new("");
+	all = g_string_new("");
+	srd_init(NULL);
+	fail_unless(srd_decoder_load(edges_pds[_i].id) == SRD_OK);
+	edges_decode(_i, &cap, TRUE, edges);
+	edges_decode(_i, &cap, FALSE, all);
+	srd_exit();
+
+	fail_unless(all->len > 0, "%s: no annotations.", edges_pds[_i].id);
+	fail_unless(!strcmp(edges->str, all->str),
+			"%s: annotations differ with edges_only.",
+			edges_pds[_i].id);
+	g_string_free(edges, TRUE);
+	g_string_free(all, TRUE);
+	g_free(cap.samples);
+}
+END_TEST
+
 Suite *suite_decoder(void)
 {
 	Suite *s;
@@ -349,5 +624,10 @@ Suite *suite_decoder(void)
 	tcase_add_test(tc, test_doc_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("edges_only");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_loop_test(tc, test_edges_only, 0, G_N_ELEMENTS(edges_pds));
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -20,7 +20,9 @@
 
 #include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
+#include "lib.h"
 
 static void setup(void)
 {
@@ -149,6 +151,316 @@ START_TEST(test_inst_option_set_bogus)
 }
 END_TEST
 
+/*
+ * Decode the capture with the trace PD, decimated by factor, in chunks
+ * which don't line up with the groups. Returns the changes it sees.
+ */
+static char *decimation_run(const uint8_t *samples, uint64_t factor,
+		int mode)
+{
+	int ret;
+	struct srd_session *sess;
+	struct srd_decoder_inst *inst;
+	GString *anns;
+	char *changes;
+
+	anns = g_string_new("");
+	sess = srdtest_session_new("trace", NULL, anns);
+	inst = srd_inst_find_by_id(sess, "trace");
+	/* The last setting holds. */
+	ret = srd_inst_decimation_set(inst, 16, SRD_DECIMATE_MAJORITY);
+	fail_unless(ret == SRD_OK, "srd_inst_decimation_set() failed: %d.",
+			ret);
+	ret = srd_inst_decimation_set(inst, factor, mode);
+	fail_unless(ret == SRD_OK, "srd_inst_decimation_set() failed: %d.",
+			ret);
+	srdtest_session_start(sess, 10000000);
+	srdtest_send(sess, samples, 1000, 333);
+	srd_session_destroy(sess);
+
+	changes = srdtest_anns_format(anns->str, 1);
+	g_string_free(anns, TRUE);
+
+	return changes;
+}
+
+/*
+ * Check whether decimated samples take the value of most samples in their
+ * group, or show every change however short, depending on the mode, and
+ * whether the decoder's sample numbers are those of the capture.
+ * If the decoder sees other changes (or it segfaults) this test will fail.
+ */
+START_TEST(test_inst_decimation_set)
+{
+	uint8_t samples[1000];
+	char *dir, *changes;
+
+	/* A pulse of 3 samples, then a rise and a fall halfway into groups. */
+	memset(samples, 0x00, sizeof(samples));
+	memset(samples, 0x01, 100);
+	memset(samples + 203, 0x01, 3);
+	memset(samples + 305, 0x01, 300);
+
+	dir = srdtest_trace_init();
+
+	changes = decimation_run(samples, 10, SRD_DECIMATE_MAJORITY);
+	fail_unless(!strcmp(changes,
+			"trace 0-0 1 01\n"
+			"trace 100-100 1 00\n"
+			/* A tie keeps the previous value. */
+			"trace 310-310 1 01\n"
+			"trace 610-610 1 00\n"),
+			"Unexpected changes:\n%s", changes);
+	g_free(changes);
+
+	changes = decimation_run(samples, 10, SRD_DECIMATE_EDGES);
+	fail_unless(!strcmp(changes,
+			"trace 0-0 1 01\n"
+			"trace 100-100 1 00\n"
+			/* The pulse lasts for one group. */
+			"trace 200-200 1 01\n"
+			"trace 210-210 1 00\n"
+			"trace 300-300 1 01\n"
+			"trace 600-600 1 00\n"),
+			"Unexpected changes:\n%s", changes);
+	g_free(changes);
+
+	/* Turned off again, every sample is decoded. */
+	changes = decimation_run(samples, 0, SRD_DECIMATE_MAJORITY);
+	fail_unless(!strcmp(changes,
+			"trace 0-0 1 01\n"
+			"trace 100-100 1 00\n"
+			"trace 203-203 1 01\n"
+			"trace 206-206 1 00\n"
+			"trace 305-305 1 01\n"
+			"trace 605-605 1 00\n"),
+			"Unexpected changes:\n%s", changes);
+	g_free(changes);
+
+	srdtest_trace_exit(dir);
+}
+END_TEST
+
+/*
+ * Check whether srd_inst_decimation_set() fails for bogus arguments.
+ * If it returns SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_inst_decimation_set_bogus)
+{
+	struct srd_session *sess;
+	struct srd_decoder_inst *inst1, *inst2;
+
+	srd_init(NULL);
+	srd_decoder_load_all();
+	srd_session_new(&sess);
+	inst1 = srd_inst_new(sess, "uart", NULL);
+	inst2 = srd_inst_new(sess, "uart", NULL);
+
+	fail_unless(srd_inst_decimation_set(NULL, 16,
+			SRD_DECIMATE_MAJORITY) != SRD_OK);
+	fail_unless(srd_inst_decimation_set(inst1, 16, -1) != SRD_OK);
+
+	/* Stacked instances don't get samples from the frontend. */
+	srd_inst_stack(sess, inst1, inst2);
+	fail_unless(srd_inst_decimation_set(inst2, 16,
+			SRD_DECIMATE_MAJORITY) != SRD_OK);
+
+	srd_exit();
+}
+END_TEST
+
+/* Append an I2C write of the given bytes to buf, 6 samples per half bit. */
+static int i2c_write(uint8_t *buf, const uint8_t *bytes, int num_bytes)
+{
+	int len, i, bit, d, k;
+
+	len = 0;
+	/* Idle, START: SDA falls while SCL is high. */
+	for (k = 0; k < 30; k++)
+		buf[len++] = 0x03;
+	for (k = 0; k < 6; k++)
+		buf[len++] = 0x01;
+	for (i = 0; i < num_bytes; i++) {
+		/* Eight data bits, then the ACK bit. */
+		for (bit = 7; bit >= -1; bit--) {
+			d = bit >= 0 ? (bytes[i] >> bit) & 1 : 0;
+			for (k = 0; k < 6; k++)
+				buf[len++] = d << 1;
+			for (k = 0; k < 6; k++)
+				buf[len++] = 0x01 | (d << 1);
+			for (k = 0; k < 6; k++)
+				buf[len++] = d << 1;
+		}
+	}
+	/* STOP: SDA rises while SCL is high. */
+	for (k = 0; k < 6; k++)
+		buf[len++] = 0x00;
+	for (k = 0; k < 6; k++)
+		buf[len++] = 0x01;
+	for (k = 0; k < 30; k++)
+		buf[len++] = 0x03;
+
+	return len;
+}
+
+/*
+ * Check whether instances can be stacked on a single output stream, and
+ * only get that one.
+ * If any call returns != SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_inst_stack_proto)
+{
+	int ret, len;
+	struct srd_session *sess;
+	struct srd_decoder_inst *i2c, *demux, *lm75_48, *lm75_49;
+	struct srd_pd_output *pdo;
+	GHashTable *options, *probes;
+	/* Address 0x48 and 0x49, write, pointer register 0. */
+	const uint8_t bytes[] = { 0x90, 0x00 };
+	const uint8_t bytes_49[] = { 0x92, 0x00 };
+	uint8_t buf[1000];
+
+	srd_init(NULL);
+	srd_decoder_load_all();
+	srd_session_new(&sess);
+	options = g_hash_table_new(g_str_hash, g_str_equal);
+	i2c = srd_inst_new(sess, "i2c", options);
+	demux = srd_inst_new(sess, "i2cdemux", options);
+	lm75_48 = srd_inst_new(sess, "lm75", options);
+	lm75_49 = srd_inst_new(sess, "lm75", options);
+	g_hash_table_destroy(options);
+	probes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(probes, "scl",
+			g_variant_ref_sink(g_variant_new_int32(0)));
+	g_hash_table_insert(probes, "sda",
+			g_variant_ref_sink(g_variant_new_int32(1)));
+	srd_inst_probe_set_all(i2c, probes);
+
+	srd_inst_stack(sess, i2c, demux);
+	ret = srd_inst_stack_proto(sess, demux, lm75_48, "i2c-0x48");
+	fail_unless(ret == SRD_OK, "srd_inst_stack_proto() failed: %d.", ret);
+	ret = srd_inst_stack_proto(sess, demux, lm75_49, "i2c-0x49");
+	fail_unless(ret == SRD_OK, "srd_inst_stack_proto() failed: %d.", ret);
+	/* More streams for the same instance add to those it takes. */
+	ret = srd_inst_stack_proto(sess, demux, lm75_48, "i2c-0x4a");
+	fail_unless(ret == SRD_OK, "srd_inst_stack_proto() failed: %d.", ret);
+	fail_unless(g_slist_length(demux->next_di) == 2);
+
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(1000000));
+	srd_session_start(sess);
+	len = i2c_write(buf, bytes, 2);
+	ret = srd_session_send(sess, 0, len, buf, len, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+
+	/* The demuxer found one slave, and only routes it to one instance. */
+	fail_unless(g_slist_length(demux->pd_output) == 1);
+	pdo = demux->pd_output->data;
+	fail_unless(!strcmp(pdo->proto_id, "i2c-0x48"));
+	fail_unless(g_slist_length(pdo->next_di) == 1);
+	fail_unless(pdo->next_di->data == lm75_48);
+
+	/* Same for another slave, and another instance. */
+	len = i2c_write(buf, bytes_49, 2);
+	ret = srd_session_send(sess, 1000, 1000 + len, buf, len, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	fail_unless(g_slist_length(demux->pd_output) == 2);
+	pdo = demux->pd_output->next->data;
+	fail_unless(!strcmp(pdo->proto_id, "i2c-0x49"));
+	fail_unless(g_slist_length(pdo->next_di) == 1);
+	fail_unless(pdo->next_di->data == lm75_49);
+
+	fail_unless(srd_inst_stack_proto(NULL, demux, lm75_48, NULL)
+			!= SRD_OK);
+	fail_unless(srd_inst_stack_proto(sess, NULL, lm75_48, NULL)
+			!= SRD_OK);
+
+	srd_exit();
+}
+END_TEST
+
+struct ann_order {
+	const struct srd_decoder_inst *di;
+	uint64_t count;
+	uint64_t last;
+	uint64_t out_of_order;
+};
+
+static void ann_order_cb(struct srd_proto_data *pdata, void *cb_data)
+{
+	struct ann_order *order;
+
+	/* Count the instance's annotations, and check they come in order. */
+	order = cb_data;
+	if (pdata->pdo->di != order->di)
+		return;
+	if (pdata->start_sample < order->last)
+		order->out_of_order++;
+	order->count++;
+	order->last = pdata->start_sample;
+}
+
+/*
+ * Check whether packets queued for a PD with decode_batch() reach it, in
+ * order, however the samples below are split into chunks.
+ */
+START_TEST(test_inst_decode_batch)
+{
+	int ret, len, i;
+	struct srd_session *sess;
+	struct srd_decoder_inst *i2c, *demux, *lm75;
+	GHashTable *options, *probes;
+	/* Address 0x48, write, pointer register 0. */
+	const uint8_t bytes[] = { 0x90, 0x00 };
+	uint8_t buf[2000];
+	struct ann_order order;
+
+	srd_init(NULL);
+	srd_decoder_load_all();
+	srd_session_new(&sess);
+	options = g_hash_table_new(g_str_hash, g_str_equal);
+	i2c = srd_inst_new(sess, "i2c", options);
+	demux = srd_inst_new(sess, "i2cdemux", options);
+	lm75 = srd_inst_new(sess, "lm75", options);
+	g_hash_table_destroy(options);
+	probes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(probes, "scl",
+			g_variant_ref_sink(g_variant_new_int32(0)));
+	g_hash_table_insert(probes, "sda",
+			g_variant_ref_sink(g_variant_new_int32(1)));
+	srd_inst_probe_set_all(i2c, probes);
+	srd_inst_stack(sess, i2c, demux);
+	srd_inst_stack(sess, demux, lm75);
+
+	memset(&order, 0, sizeof(order));
+	order.di = lm75;
+	srd_pd_output_callback_add(sess, SRD_OUTPUT_ANN, ann_order_cb, &order);
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(1000000));
+	srd_session_start(sess);
+	fail_unless(demux->decode_batch);
+	fail_unless(!lm75->decode_batch);
+
+	len = i2c_write(buf, bytes, 2);
+	len += i2c_write(buf + len, bytes, 2);
+	for (i = 0; i < len; i += 37) {
+		ret = srd_session_send(sess, i, MIN(i + 37, len), buf + i,
+				MIN(37, len - i), 1);
+		fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.",
+				ret);
+		/* Nothing is left queued once the chunk is decoded. */
+		fail_unless(demux->py_batch == NULL);
+	}
+	fail_unless(order.count > 0, "No annotations.");
+	fail_unless(order.out_of_order == 0, "%" PRIu64 " annotations out "
+			"of order.", order.out_of_order);
+
+	srd_exit();
+}
+END_TEST
+
 Suite *suite_inst(void)
 {
 	Suite *s;
@@ -168,5 +480,17 @@ Suite *suite_inst(void)
 	tcase_add_test(tc, test_inst_option_set_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("decimation");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_inst_decimation_set);
+	tcase_add_test(tc, test_inst_decimation_set_bogus);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stack");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_inst_stack_proto);
+	tcase_add_test(tc, test_inst_decode_batch);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
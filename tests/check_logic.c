@@ -0,0 +1,838 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "lib.h"
+
+#define NUM_SAMPLES 1000
+/* A multiple of the clock's half period, so chunks start on an edge. */
+#define CHUNK_SAMPLES 99
+
+/*
+ * Puts an annotation at each sample matching the conditions, found either
+ * by wait(), or by iterating over all samples and checking them in Python.
+ * The annotation holds the probe values at that sample.
+ */
+static const char *wait_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"def matches(conds, pins, prev):\n"
+	"    if conds is None:\n"
+	"        return True\n"
+	"    for cond in [conds] if isinstance(conds, dict) else conds:\n"
+	"        for p, t in cond.items():\n"
+	"            if t == 'l':\n"
+	"                ok = pins[p] == 0\n"
+	"            elif t == 'h':\n"
+	"                ok = pins[p] == 1\n"
+	"            elif t == 'r':\n"
+	"                ok = pins[p] == 1 and prev[p] == 0\n"
+	"            elif t == 'f':\n"
+	"                ok = pins[p] == 0 and prev[p] == 1\n"
+	"            else:\n"
+	"                ok = pins[p] != prev[p]\n"
+	"            if not ok:\n"
+	"                break\n"
+	"        else:\n"
+	"            return True\n"
+	"    return False\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'waitcheck'\n"
+	"    name = 'Wait'\n"
+	"    longname = 'Wait check'\n"
+	"    desc = 'Lists the samples matching wait() conditions.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['waitcheck']\n"
+	"    probes = [\n"
+	"        {'id': 'd0', 'name': 'D0', 'desc': ''},\n"
+	"        {'id': 'd1', 'name': 'D1', 'desc': ''},\n"
+	"        {'id': 'd2', 'name': 'D2', 'desc': ''},\n"
+	"    ]\n"
+	"    options = {\n"
+	"        'mode': ['wait or iter', 'wait'],\n"
+	"        'conds': ['The conditions, as a Python expression', 'None'],\n"
+	"    }\n"
+	"    annotations = [['match', 'Match']]\n"
+	"\n"
+	"    def __init__(self):\n"
+	"        self.prev = None\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"        self.conds = eval(self.options['conds'])\n"
+	"\n"
+	"    def match(self, samplenum, pins):\n"
+	"        value = '%d%d%d' % (pins[2], pins[1], pins[0])\n"
+	"        self.put(samplenum, samplenum, self.out_ann, [0, [value]])\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        if self.options['mode'] == 'wait':\n"
+	"            while True:\n"
+	"                s = data.wait(self.conds)\n"
+	"                if s is None:\n"
+	"                    break\n"
+	"                self.match(*s)\n"
+	"        else:\n"
+	"            for samplenum, pins in data:\n"
+	"                if self.prev is None:\n"
+	"                    self.prev = pins\n"
+	"                if matches(self.conds, pins, self.prev):\n"
+	"                    self.match(samplenum, pins)\n"
+	"                self.prev = pins\n";
+
+/*
+ * Puts an annotation over each chunk, holding the size of the raw buffer
+ * and the offset of the first byte of 0x01 in it. With 'keep', it holds on
+ * to a slice of the buffer after decode() returns.
+ */
+static const char *buffer_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'buffercheck'\n"
+	"    name = 'Buffer'\n"
+	"    longname = 'Buffer check'\n"
+	"    desc = 'Looks at the raw buffer of each chunk.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['buffercheck']\n"
+	"    probes = [{'id': 'd0', 'name': 'D0', 'desc': ''}]\n"
+	"    options = {'keep': ['Keep a view', 'no']}\n"
+	"    annotations = [['buffer', 'Buffer']]\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        with memoryview(data) as view:\n"
+	"            value = '%d %d' % (len(view), bytes(view).find(b'\\x01'))\n"
+	"            if self.options['keep'] == 'yes':\n"
+	"                self.kept = view[4:]\n"
+	"        self.put(ss, es, self.out_ann, [0, [value]])\n";
+
+/*
+ * Skips to each of the target samples in turn, with skip(), and takes the
+ * sample after each one from the iterator. Or iterates over all samples,
+ * and works out in Python which samples that should give. With 'edges',
+ * the iterator only returns changes. The annotations hold the probe
+ * values at those samples.
+ */
+static const char *skip_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'skipcheck'\n"
+	"    name = 'Skip'\n"
+	"    longname = 'Skip check'\n"
+	"    desc = 'Lists the samples skip() goes to.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['skipcheck']\n"
+	"    probes = [\n"
+	"        {'id': 'd0', 'name': 'D0', 'desc': ''},\n"
+	"        {'id': 'd1', 'name': 'D1', 'desc': ''},\n"
+	"        {'id': 'd2', 'name': 'D2', 'desc': ''},\n"
+	"    ]\n"
+	"    options = {\n"
+	"        'mode': ['skip or iter', 'skip'],\n"
+	"        'targets': ['The samples to skip to, as a Python list', '[]'],\n"
+	"        'edges': ['Only iterate over changes', 'no'],\n"
+	"    }\n"
+	"    annotations = [['skip', 'Skip'], ['next', 'Next']]\n"
+	"\n"
+	"    def __init__(self):\n"
+	"        self.idx = 0\n"
+	"        self.pos = 0\n"
+	"        self.want_next = False\n"
+	"        self.prev = None\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"        self.targets = eval(self.options['targets'])\n"
+	"        self.edges = self.options['edges'] == 'yes'\n"
+	"        self.edges_only = self.edges and self.options['mode'] == 'skip'\n"
+	"\n"
+	"    def match(self, ann, samplenum, pins):\n"
+	"        value = '%d%d%d' % (pins[2], pins[1], pins[0])\n"
+	"        self.put(samplenum, samplenum, self.out_ann, [ann, [value]])\n"
+	"\n"
+	"    def follow(self, samplenum, pins):\n"
+	"        if self.want_next:\n"
+	"            if not self.edges or pins != self.prev:\n"
+	"                self.match(1, samplenum, pins)\n"
+	"                self.want_next = False\n"
+	"                self.pos = samplenum + 1\n"
+	"        elif self.idx < len(self.targets) and \\\n"
+	"                samplenum == max(self.targets[self.idx], self.pos):\n"
+	"            self.match(0, samplenum, pins)\n"
+	"            self.idx += 1\n"
+	"            self.want_next = True\n"
+	"            self.pos = samplenum + 1\n"
+	"        self.prev = pins\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        if self.options['mode'] == 'iter':\n"
+	"            for samplenum, pins in data:\n"
+	"                self.follow(samplenum, pins)\n"
+	"            return\n"
+	"        while True:\n"
+	"            if self.want_next:\n"
+	"                s = next(data, None)\n"
+	"                if s is None:\n"
+	"                    return\n"
+	"                self.match(1, *s)\n"
+	"                self.want_next = False\n"
+	"            if self.idx == len(self.targets):\n"
+	"                return\n"
+	"            s = data.skip(self.targets[self.idx])\n"
+	"            if s is None:\n"
+	"                return\n"
+	"            self.match(0, *s)\n"
+	"            self.idx += 1\n"
+	"            self.want_next = True\n";
+
+/*
+ * Lists the changes of probes 0 and 1 from edges(), or found by iterating
+ * over all samples. In 'shared' mode, notes each chunk in which edges()
+ * gives the same object as it gave the previous instance.
+ */
+static const char *edges_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"shared = [None, None]\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'edgescheck'\n"
+	"    name = 'Edges'\n"
+	"    longname = 'Edges check'\n"
+	"    desc = 'Lists the changes edges() finds.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['edgescheck']\n"
+	"    probes = [\n"
+	"        {'id': 'd0', 'name': 'D0', 'desc': ''},\n"
+	"        {'id': 'd1', 'name': 'D1', 'desc': ''},\n"
+	"    ]\n"
+	"    options = {\n"
+	"        'mode': ['edges, iter or shared', 'edges'],\n"
+	"    }\n"
+	"    annotations = [['d0', 'D0'], ['d1', 'D1'], ['shared', 'Shared']]\n"
+	"\n"
+	"    def __init__(self):\n"
+	"        self.prev = None\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        mode = self.options['mode']\n"
+	"        if mode == 'edges':\n"
+	"            edges = [(s, probe) for probe in range(2)\n"
+	"                     for s in data.edges(probe)]\n"
+	"            for s, probe in sorted(edges):\n"
+	"                if not ss <= s < es:\n"
+	"                    raise Exception('Edge %d not in %d-%d.' % (s, ss, es))\n"
+	"                self.put(s, s, self.out_ann, [probe, ['e']])\n"
+	"        elif mode == 'iter':\n"
+	"            for samplenum, pins in data:\n"
+	"                for probe in range(2):\n"
+	"                    if self.prev and pins[probe] != self.prev[probe]:\n"
+	"                        self.put(samplenum, samplenum, self.out_ann,\n"
+	"                                 [probe, ['e']])\n"
+	"                self.prev = pins\n"
+	"        else:\n"
+	"            obj = data.edges(0).obj\n"
+	"            if shared[0] == ss and shared[1] is obj:\n"
+	"                self.put(ss, ss, self.out_ann, [2, ['shared']])\n"
+	"            shared[:] = [ss, obj]\n";
+
+static void setup(void)
+{
+	/* Silence libsigrokdecode while the unit tests run. */
+	srd_log_loglevel_set(SRD_LOG_NONE);
+}
+
+static void teardown(void)
+{
+}
+
+/*
+ * Probe 0 is a clock toggling every 3 samples, starting low. Probe 1
+ * changes at random, holding its value for a few samples on average.
+ * Probe 2 is always low.
+ */
+static void wait_capture(uint8_t *samples)
+{
+	uint32_t rnd;
+	int n, d1;
+
+	rnd = 1;
+	d1 = 0;
+	for (n = 0; n < NUM_SAMPLES; n++) {
+		rnd = rnd * 1103515245 + 12345;
+		if ((rnd >> 16) % 4 == 0)
+			d1 = !d1;
+		samples[n] = (n / 3) % 2 | d1 << 1;
+	}
+}
+
+/*
+ * Send the capture to a started session as raw samples, or run-length
+ * encoded, in chunks of CHUNK_SAMPLES.
+ */
+static void capture_send(struct srd_session *sess, gboolean rle)
+{
+	uint8_t samples[NUM_SAMPLES], values[CHUNK_SAMPLES];
+	uint64_t runlengths[CHUNK_SAMPLES], start, end, num_runs, n;
+	int ret;
+
+	wait_capture(samples);
+	for (start = 0; start < NUM_SAMPLES; start = end) {
+		end = MIN(start + CHUNK_SAMPLES, NUM_SAMPLES);
+		if (!rle) {
+			ret = srd_session_send(sess, start, end,
+					samples + start, end - start, 1);
+			fail_unless(ret == SRD_OK, "srd_session_send() "
+					"failed: %d.", ret);
+			continue;
+		}
+		num_runs = 0;
+		for (n = start; n < end; n++) {
+			if (n > start && samples[n] == samples[n - 1]) {
+				runlengths[num_runs - 1]++;
+				continue;
+			}
+			values[num_runs] = samples[n];
+			runlengths[num_runs++] = 1;
+		}
+		ret = srd_session_send_rle(sess, start, values, runlengths,
+				num_runs, 1);
+		fail_unless(ret == SRD_OK, "srd_session_send_rle() failed: %d.",
+				ret);
+	}
+}
+
+/* Decimate the instance by factor, unless that's 0. */
+static void logic_decimate(struct srd_session *sess, const char *inst_id,
+		uint64_t factor)
+{
+	struct srd_decoder_inst *inst;
+	int ret;
+
+	if (!factor)
+		return;
+	inst = srd_inst_find_by_id(sess, inst_id);
+	ret = srd_inst_decimation_set(inst, factor, SRD_DECIMATE_MAJORITY);
+	fail_unless(ret == SRD_OK, "srd_inst_decimation_set() failed: %d.",
+			ret);
+}
+
+/*
+ * Send the capture through the wait() PD in the given mode, and return
+ * the annotations.
+ */
+static char *wait_run(const char *mode, const char *conds, gboolean rle)
+{
+	struct srd_session *sess;
+	GHashTable *options;
+	GString *anns;
+
+	anns = g_string_new(NULL);
+	options = srdtest_options_new("mode", g_variant_new_string(mode),
+			"conds", g_variant_new_string(conds), NULL);
+	sess = srdtest_session_new("waitcheck", options, anns);
+	g_hash_table_destroy(options);
+	srdtest_session_start(sess, 1000000);
+	capture_send(sess, rle);
+	srd_session_destroy(sess);
+
+	return g_string_free(anns, FALSE);
+}
+
+/*
+ * Run the conditions through wait() and through plain iteration, on raw
+ * and on run-length encoded chunks, and check that all four agree.
+ * Returns the annotations.
+ */
+static char *wait_check(const char *conds)
+{
+	char *wait_raw, *wait_rle, *iter_raw, *iter_rle;
+
+	wait_raw = wait_run("wait", conds, FALSE);
+	wait_rle = wait_run("wait", conds, TRUE);
+	iter_raw = wait_run("iter", conds, FALSE);
+	iter_rle = wait_run("iter", conds, TRUE);
+	fail_unless(!strcmp(wait_raw, iter_raw),
+			"wait(%s) differs from iterating.", conds);
+	fail_unless(!strcmp(wait_rle, iter_rle),
+			"wait(%s) differs from iterating, with runs.", conds);
+	fail_unless(!strcmp(wait_raw, wait_rle),
+			"wait(%s) differs between raw and runs.", conds);
+	g_free(wait_rle);
+	g_free(iter_raw);
+	g_free(iter_rle);
+
+	return wait_raw;
+}
+
+static int count_lines(const char *s)
+{
+	int n;
+
+	for (n = 0; (s = strchr(s, '\n')); s++)
+		n++;
+
+	return n;
+}
+
+/*
+ * Check whether wait() finds the same samples as iterating over all of
+ * them does, for each type of condition, on raw and on run-length encoded
+ * chunks.
+ * If any of them differ (or it segfaults) this test will fail.
+ */
+START_TEST(test_logic_wait)
+{
+	const char *conds[] = {
+		"None",
+		"{0: 'l'}",
+		"{0: 'h'}",
+		"{0: 'r'}",
+		"{0: 'f'}",
+		"{0: 'e'}",
+		"{1: 'l'}",
+		"{1: 'r'}",
+		"{1: 'e'}",
+		"{0: 'r', 1: 'h'}",
+		"{0: 'f', 1: 'e'}",
+		"[{0: 'r'}, {1: 'f'}]",
+		"[{0: 'f', 1: 'l'}, {1: 'r', 0: 'h'}, {2: 'h'}]",
+	};
+	char *dir, *anns;
+	unsigned int i;
+
+	dir = srdtest_pd_dir_new("waitcheck", wait_pd);
+	srd_init(dir);
+	srd_decoder_load("waitcheck");
+
+	for (i = 0; i < G_N_ELEMENTS(conds); i++) {
+		anns = wait_check(conds[i]);
+		g_free(anns);
+	}
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "waitcheck");
+}
+END_TEST
+
+/*
+ * Check whether wait() finds edges at the start of a chunk, which it only
+ * sees by comparing with the last sample of the chunk before.
+ * If it misses any (or segfaults) this test will fail.
+ */
+START_TEST(test_logic_wait_edges)
+{
+	char *dir, *anns;
+
+	dir = srdtest_pd_dir_new("waitcheck", wait_pd);
+	srd_init(dir);
+	srd_decoder_load("waitcheck");
+
+	/* The clock rises at sample 3, and then every 6 samples. */
+	anns = wait_check("{0: 'r'}");
+	fail_unless(count_lines(anns) == (NUM_SAMPLES - 3 + 5) / 6);
+	fail_unless(!strncmp(anns, "waitcheck 3-3 0 ", 16));
+	/* Sample 99 starts the second chunk. */
+	fail_unless(strstr(anns, "waitcheck 99-99 0 ") != NULL,
+			"Rising edge at the start of a chunk was missed.");
+	g_free(anns);
+
+	/* It changes every 3 samples, but not at the very first one. */
+	anns = wait_check("{0: 'e'}");
+	fail_unless(count_lines(anns) == (NUM_SAMPLES - 1) / 3);
+	fail_unless(strstr(anns, "waitcheck 0-0 ") == NULL);
+	fail_unless(strstr(anns, "waitcheck 198-198 0 ") != NULL);
+	g_free(anns);
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "waitcheck");
+}
+END_TEST
+
+/*
+ * Check whether wait() returns None when nothing in the chunk matches,
+ * so decode() returns and waits again in the next one.
+ * If anything is found (or it segfaults) this test will fail.
+ */
+START_TEST(test_logic_wait_none)
+{
+	char *dir, *anns;
+
+	dir = srdtest_pd_dir_new("waitcheck", wait_pd);
+	srd_init(dir);
+	srd_decoder_load("waitcheck");
+
+	anns = wait_check("{2: 'h'}");
+	fail_unless(anns[0] == '\0', "Found a match on a probe kept low.");
+	g_free(anns);
+	anns = wait_check("[{2: 'e'}, {0: 'h', 2: 'h'}]");
+	fail_unless(anns[0] == '\0', "Found a match on a probe kept low.");
+	g_free(anns);
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "waitcheck");
+}
+END_TEST
+
+/*
+ * The same for the skip() PD, with the instance decimated by factor
+ * unless that's 0.
+ */
+static char *skip_run(const char *mode, const char *targets,
+		const char *edges, uint64_t factor, gboolean rle)
+{
+	struct srd_session *sess;
+	GHashTable *options;
+	GString *anns;
+
+	anns = g_string_new(NULL);
+	options = srdtest_options_new("mode", g_variant_new_string(mode),
+			"targets", g_variant_new_string(targets),
+			"edges", g_variant_new_string(edges), NULL);
+	sess = srdtest_session_new("skipcheck", options, anns);
+	g_hash_table_destroy(options);
+	logic_decimate(sess, "skipcheck", factor);
+	srdtest_session_start(sess, 1000000);
+	capture_send(sess, rle);
+	srd_session_destroy(sess);
+
+	return g_string_free(anns, FALSE);
+}
+
+/*
+ * Run the targets through skip() and through plain iteration, on raw and
+ * on run-length encoded chunks, and check that all four agree. Returns
+ * the annotations.
+ */
+static char *skip_check(const char *targets, const char *edges,
+		uint64_t factor)
+{
+	char *skip_raw, *skip_rle, *iter_raw, *iter_rle;
+
+	skip_raw = skip_run("skip", targets, edges, factor, FALSE);
+	skip_rle = skip_run("skip", targets, edges, factor, TRUE);
+	iter_raw = skip_run("iter", targets, edges, factor, FALSE);
+	iter_rle = skip_run("iter", targets, edges, factor, TRUE);
+	fail_unless(!strcmp(skip_raw, iter_raw),
+			"skip(%s) differs from iterating.", targets);
+	fail_unless(!strcmp(skip_rle, iter_rle),
+			"skip(%s) differs from iterating, with runs.", targets);
+	fail_unless(!strcmp(skip_raw, skip_rle),
+			"skip(%s) differs between raw and runs.", targets);
+	g_free(skip_rle);
+	g_free(iter_raw);
+	g_free(iter_rle);
+
+	return skip_raw;
+}
+
+/*
+ * Check whether skip() goes to the same samples as iterating over all of
+ * them does: to a target in the chunk, to the next sample for a target
+ * already passed, and for a target in a later chunk, to nothing until
+ * that chunk comes. In edges-only mode, the iterator has to carry on from
+ * the sample skipped to, so the next change is neither lost nor repeated.
+ * If any of them differ (or it segfaults) this test will fail.
+ */
+START_TEST(test_logic_skip)
+{
+	/* Chunks start at 0, 99, 198, ...; 2000 is past the end. */
+	const char *targets = "[5, 3, 40, 40, 97, 150, 151, 600, 2000]";
+	char *dir, *anns;
+
+	dir = srdtest_pd_dir_new("skipcheck", skip_pd);
+	srd_init(dir);
+	srd_decoder_load("skipcheck");
+
+	anns = skip_check(targets, "no", 0);
+	fail_unless(strstr(anns, "skipcheck 5-5 0 ") != NULL);
+	/* 3 was passed by then, 7 comes after 5 and the sample after it. */
+	fail_unless(strstr(anns, "skipcheck 7-7 0 ") != NULL);
+	fail_unless(strstr(anns, "skipcheck 42-42 0 ") != NULL);
+	/* Skipped to in the second chunk. */
+	fail_unless(strstr(anns, "skipcheck 150-150 0 ") != NULL);
+	fail_unless(strstr(anns, "skipcheck 152-152 0 ") != NULL);
+	fail_unless(strstr(anns, "skipcheck 600-600 0 ") != NULL);
+	fail_unless(count_lines(anns) == 16,
+			"Unexpected samples:\n%s", anns);
+	g_free(anns);
+
+	anns = skip_check(targets, "yes", 0);
+	fail_unless(strstr(anns, "skipcheck 5-5 0 ") != NULL);
+	/* The clock changes at 6, the sample after 5. */
+	fail_unless(strstr(anns, "skipcheck 6-6 1 ") != NULL);
+	g_free(anns);
+
+	/*
+	 * Decimated by 4, the targets are numbers of the 250 decimated
+	 * samples, which put() turns back into those of the capture.
+	 */
+	anns = skip_check(targets, "no", 4);
+	fail_unless(strstr(anns, "skipcheck 20-20 0 ") != NULL);
+	fail_unless(strstr(anns, "skipcheck 600-600 0 ") != NULL);
+	fail_unless(count_lines(anns) == 14,
+			"Unexpected samples:\n%s", anns);
+	g_free(anns);
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "skipcheck");
+}
+END_TEST
+
+/*
+ * The same for the edges() PD, with the instance decimated by factor
+ * unless that's 0.
+ */
+static char *edges_run(const char *mode, uint64_t factor, gboolean rle)
+{
+	struct srd_session *sess;
+	GHashTable *options;
+	GString *anns;
+
+	anns = g_string_new(NULL);
+	options = srdtest_options_new("mode", g_variant_new_string(mode),
+			NULL);
+	sess = srdtest_session_new("edgescheck", options, anns);
+	g_hash_table_destroy(options);
+	logic_decimate(sess, "edgescheck", factor);
+	srdtest_session_start(sess, 1000000);
+	capture_send(sess, rle);
+	srd_session_destroy(sess);
+
+	return g_string_free(anns, FALSE);
+}
+
+/*
+ * Check whether edges() and plain iteration find the same changes, on raw
+ * and on run-length encoded chunks. Returns the changes.
+ */
+static char *edges_check(uint64_t factor)
+{
+	char *edges_raw, *edges_rle, *iter_raw, *iter_rle;
+
+	edges_raw = edges_run("edges", factor, FALSE);
+	edges_rle = edges_run("edges", factor, TRUE);
+	iter_raw = edges_run("iter", factor, FALSE);
+	iter_rle = edges_run("iter", factor, TRUE);
+	fail_unless(!strcmp(edges_raw, iter_raw),
+			"edges() differs from iterating.");
+	fail_unless(!strcmp(edges_rle, iter_rle),
+			"edges() differs from iterating, with runs.");
+	fail_unless(!strcmp(edges_raw, edges_rle),
+			"edges() differs between raw and runs.");
+	g_free(edges_rle);
+	g_free(iter_raw);
+	g_free(iter_rle);
+
+	return edges_raw;
+}
+
+/*
+ * Check whether edges() gives the changes iterating finds, including one
+ * at the first sample of a chunk, and for a decimated instance, whose
+ * changes are numbers of the decimated samples, between the ss and es
+ * passed to decode().
+ * If any of them differ (or it segfaults) this test will fail.
+ */
+START_TEST(test_logic_edges)
+{
+	char *dir, *anns, **lines;
+	uint64_t start;
+	int i;
+
+	dir = srdtest_pd_dir_new("edgescheck", edges_pd);
+	srd_init(dir);
+	srd_decoder_load("edgescheck");
+
+	anns = edges_check(0);
+	fail_unless(strstr(anns, "edgescheck 3-3 0 ") != NULL);
+	/* Sample 99 starts the second chunk. */
+	fail_unless(strstr(anns, "edgescheck 99-99 0 ") != NULL,
+			"Change at the start of a chunk was missed.");
+	/* Nothing came before the first sample. */
+	fail_unless(strstr(anns, "edgescheck 0-0 ") == NULL);
+	g_free(anns);
+
+	anns = edges_check(4);
+	fail_unless(count_lines(anns) > 0);
+	/* put() turned them back into sample numbers of the capture. */
+	lines = g_strsplit(anns, "\n", 0);
+	for (i = 0; lines[i] && *lines[i]; i++) {
+		fail_unless(sscanf(lines[i], "edgescheck %" SCNu64 "-",
+				&start) == 1);
+		fail_unless(start % 4 == 0, "Change at %" PRIu64 ".", start);
+	}
+	g_strfreev(lines);
+	g_free(anns);
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "edgescheck");
+}
+END_TEST
+
+/*
+ * Check whether two instances on the same probe get the same list from
+ * edges(), rather than each building its own.
+ * If it's built twice for any chunk (or it segfaults) this test will fail.
+ */
+START_TEST(test_logic_edges_shared)
+{
+	struct srd_session *sess;
+	GHashTable *options;
+	GString *anns;
+	char *dir;
+	int rle;
+
+	dir = srdtest_pd_dir_new("edgescheck", edges_pd);
+	srd_init(dir);
+	srd_decoder_load("edgescheck");
+
+	for (rle = 0; rle < 2; rle++) {
+		anns = g_string_new(NULL);
+		options = srdtest_options_new("mode",
+				g_variant_new_string("shared"), NULL);
+		sess = srdtest_session_new("edgescheck", options, anns);
+		fail_unless(srd_inst_new(sess, "edgescheck", options) != NULL,
+				"srd_inst_new() failed.");
+		g_hash_table_destroy(options);
+		srdtest_session_start(sess, 1000000);
+		capture_send(sess, rle);
+		srd_session_destroy(sess);
+
+		/* Once per chunk, from the second instance. */
+		fail_unless(count_lines(anns->str) == (NUM_SAMPLES +
+				CHUNK_SAMPLES - 1) / CHUNK_SAMPLES,
+				"Unexpected lists:\n%s", anns->str);
+		g_string_free(anns, TRUE);
+	}
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "edgescheck");
+}
+END_TEST
+
+/*
+ * Check whether decode() sees the chunk's raw samples through the buffer
+ * protocol, and fails if it keeps a view on them after returning.
+ * If it sees other samples, or a kept view goes unnoticed (or it
+ * segfaults) this test will fail.
+ */
+START_TEST(test_logic_buffer)
+{
+	struct srd_session *sess;
+	GHashTable *options;
+	GString *anns;
+	uint8_t samples[300];
+	char *dir;
+	int ret;
+
+	memset(samples, 0x00, sizeof(samples));
+	samples[42] = samples[250] = 0x01;
+
+	dir = srdtest_pd_dir_new("buffercheck", buffer_pd);
+	srd_init(dir);
+	srd_decoder_load("buffercheck");
+
+	anns = g_string_new("");
+	sess = srdtest_session_new("buffercheck", NULL, anns);
+	srdtest_session_start(sess, 1000000);
+	ret = srd_session_send(sess, 0, 100, samples, 100, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	ret = srd_session_send(sess, 100, 300, samples + 100, 200, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	fail_unless(!strcmp(anns->str,
+			"buffercheck 0-100 0 100 42\n"
+			"buffercheck 100-300 0 200 150\n"),
+			"Unexpected annotations:\n%s", anns->str);
+	srd_session_destroy(sess);
+	g_string_free(anns, TRUE);
+
+	/* The instance is stopped, rather than read the freed buffer. */
+	anns = g_string_new("");
+	options = srdtest_options_new("keep", g_variant_new_string("yes"),
+			NULL);
+	sess = srdtest_session_new("buffercheck", options, anns);
+	g_hash_table_destroy(options);
+	srdtest_session_start(sess, 1000000);
+	fail_unless(srd_session_send(sess, 0, 100, samples, 100, 1)
+			== SRD_ERR_PYTHON, "A view outlived decode().");
+	fail_unless(srd_session_send(sess, 100, 300, samples + 100, 200, 1)
+			!= SRD_OK, "Decoded after keeping a view.");
+	fail_unless(!strcmp(anns->str, "buffercheck 0-100 0 100 42\n"),
+			"Unexpected annotations:\n%s", anns->str);
+	srd_session_destroy(sess);
+	g_string_free(anns, TRUE);
+
+	srd_exit();
+	srdtest_pd_dir_free(dir, "buffercheck");
+}
+END_TEST
+
+Suite *suite_logic(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("logic");
+
+	tc = tcase_create("wait");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_logic_wait);
+	tcase_add_test(tc, test_logic_wait_edges);
+	tcase_add_test(tc, test_logic_wait_none);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("skip");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_logic_skip);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("edges");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_logic_edges);
+	tcase_add_test(tc, test_logic_edges_shared);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("buffer");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_logic_buffer);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
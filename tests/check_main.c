@@ -25,7 +25,9 @@
 Suite *suite_core(void);
 Suite *suite_decoder(void);
 Suite *suite_inst(void);
+Suite *suite_logic(void);
 Suite *suite_session(void);
+Suite *suite_unpack(void);
 
 int main(void)
 {
@@ -40,7 +42,9 @@ int main(void)
 	srunner_add_suite(srunner, suite_core());
 	srunner_add_suite(srunner, suite_decoder());
 	srunner_add_suite(srunner, suite_inst());
+	srunner_add_suite(srunner, suite_logic());
 	srunner_add_suite(srunner, suite_session());
+	srunner_add_suite(srunner, suite_unpack());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
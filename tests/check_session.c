@@ -20,8 +20,17 @@
 
 #include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
 #include "../libsigrokdecode-internal.h"
+#include "../config.h"
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <check.h>
+#include "lib.h"
+#ifdef HAVE_SHM_OPEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 static void setup(void)
 {
@@ -233,6 +242,921 @@ START_TEST(test_session_metadata_set_bogus)
 }
 END_TEST
 
+/*
+ * Check whether srd_session_send() and its variants for other sample
+ * formats work.
+ * If they return != SRD_OK (or segfault) this test will fail.
+ */
+START_TEST(test_session_send)
+{
+	int ret;
+	struct srd_session *sess;
+	uint8_t samples[64], values[2];
+	uint64_t runlengths[2];
+	const uint8_t *planes[2];
+
+	memset(samples, 0x03, sizeof(samples));
+	planes[0] = planes[1] = samples;
+	values[0] = values[1] = 0x03;
+	runlengths[0] = 1000;
+	runlengths[1] = 1;
+
+	srd_init(NULL);
+	srd_decoder_load("uart");
+	sess = srdtest_session_new("uart", NULL, NULL);
+	srdtest_session_start(sess, 1000000);
+
+	ret = srd_session_send(sess, 0, 64, samples, sizeof(samples), 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	ret = srd_session_send(sess, 64, 96, samples, sizeof(samples), 2);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	ret = srd_session_send_rle(sess, 96, values, runlengths, 2, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send_rle() failed: %d.", ret);
+	ret = srd_session_send_planar(sess, 1097, planes, 2, 64);
+	fail_unless(ret == SRD_OK, "srd_session_send_planar() failed: %d.",
+			ret);
+	ret = srd_session_send_planar(sess, 1161, planes, 2, 61);
+	fail_unless(ret == SRD_OK, "srd_session_send_planar() failed: %d.",
+			ret);
+
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
+/*
+ * Check whether srd_session_send() and its variants for other sample
+ * formats fail with invalid input.
+ * If they return SRD_OK (or segfault) this test will fail.
+ */
+START_TEST(test_session_send_bogus)
+{
+	struct srd_session *sess;
+	uint8_t samples[64], values[2];
+	uint64_t runlengths[2];
+	const uint8_t *planes[2];
+
+	memset(samples, 0, sizeof(samples));
+	planes[0] = planes[1] = samples;
+	values[0] = values[1] = 0;
+	runlengths[0] = 10;
+	runlengths[1] = 0;
+
+	srd_init(NULL);
+	srd_decoder_load("uart");
+	sess = srdtest_session_new("uart", NULL, NULL);
+	srdtest_session_start(sess, 1000000);
+
+	/* NULL session. */
+	fail_unless(srd_session_send(NULL, 0, 64, samples, 64, 1) != SRD_OK);
+	fail_unless(srd_session_send_rle(NULL, 0, values, runlengths, 1, 1)
+			!= SRD_OK);
+
+	/* Invalid unitsize. */
+	fail_unless(srd_session_send(sess, 0, 64, samples, 64, 0) != SRD_OK);
+	fail_unless(srd_session_send_rle(sess, 0, values, runlengths, 1, 0)
+			!= SRD_OK);
+
+	/* Missing or empty sample data. */
+	fail_unless(srd_session_send(sess, 0, 64, NULL, 64, 1) != SRD_OK);
+	fail_unless(srd_session_send(sess, 0, 64, samples, 0, 1) != SRD_OK);
+	fail_unless(srd_session_send(sess, 0, 64, samples, 1, 2) != SRD_OK);
+	fail_unless(srd_session_send_rle(sess, 0, NULL, runlengths, 1, 1)
+			!= SRD_OK);
+	fail_unless(srd_session_send_rle(sess, 0, values, NULL, 1, 1)
+			!= SRD_OK);
+	fail_unless(srd_session_send_rle(sess, 0, values, runlengths, 0, 1)
+			!= SRD_OK);
+	fail_unless(srd_session_send_planar(sess, 0, NULL, 2, 64) != SRD_OK);
+	fail_unless(srd_session_send_planar(sess, 0, planes, 0, 64) != SRD_OK);
+	fail_unless(srd_session_send_planar(sess, 0, planes, 2, 0) != SRD_OK);
+
+	/* No bitstream for a probe in use. */
+	fail_unless(srd_session_send_planar(sess, 0, planes, 1, 64) != SRD_OK);
+	planes[1] = NULL;
+	fail_unless(srd_session_send_planar(sess, 0, planes, 2, 64) != SRD_OK);
+
+	/* Empty run. */
+	fail_unless(srd_session_send_rle(sess, 0, values, runlengths, 2, 1)
+			!= SRD_OK);
+
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
+/* Probe 0 toggles every 50 samples, probe 1 every 70 samples. */
+static void trace_capture(uint8_t *samples, int num_samples)
+{
+	int i;
+
+	for (i = 0; i < num_samples; i++)
+		samples[i] = (i / 50) % 2 | ((i / 70) % 2) << 1;
+}
+
+/* Append a "chunk" annotation of the trace PD to s. */
+static void trace_chunk(GString *s, uint64_t start, uint64_t end)
+{
+	g_string_append_printf(s, "trace %" PRIu64 "-%" PRIu64 " 0 chunk\n",
+			start, end);
+}
+
+/*
+ * Check whether coalescing hands small chunks to the decoders in batches,
+ * which hold the same samples, and are sent on once the buffer is full,
+ * a chunk doesn't follow on, or when flushed.
+ * If the decoder sees other chunks or samples (or it segfaults) this test
+ * will fail.
+ */
+START_TEST(test_session_coalesce)
+{
+	int ret, i;
+	struct srd_session *sess;
+	uint8_t samples[6400];
+	GString *plain, *anns, *expected;
+	char *dir, *chunks, *changes, *plain_changes;
+
+	trace_capture(samples, 6400);
+	dir = srdtest_trace_init();
+
+	plain = g_string_new("");
+	sess = srdtest_session_new("trace", NULL, plain);
+	srdtest_session_start(sess, 1000000);
+	srdtest_send(sess, samples, 6400, 64);
+	srd_session_destroy(sess);
+
+	anns = g_string_new("");
+	sess = srdtest_session_new("trace", NULL, anns);
+	srdtest_session_start(sess, 1000000);
+	ret = srd_session_coalesce_set(sess, 1000, 0);
+	fail_unless(ret == SRD_OK, "srd_session_coalesce_set() failed: %d.",
+			ret);
+	srdtest_send(sess, samples, 6400, 64);
+
+	/* 15 chunks fit in the buffer, and the 16th sends them on. */
+	expected = g_string_new("");
+	for (i = 0; i < 6; i++)
+		trace_chunk(expected, i * 960, (i + 1) * 960);
+	chunks = srdtest_anns_format(anns->str, 0);
+	fail_unless(!strcmp(chunks, expected->str),
+			"Unexpected chunks:\n%s", chunks);
+	g_free(chunks);
+
+	ret = srd_session_flush(sess);
+	fail_unless(ret == SRD_OK, "srd_session_flush() failed: %d.", ret);
+	trace_chunk(expected, 5760, 6400);
+	changes = srdtest_anns_format(anns->str, 1);
+	plain_changes = srdtest_anns_format(plain->str, 1);
+	fail_unless(!strcmp(changes, plain_changes),
+			"Coalesced chunks hold other samples.");
+	g_free(changes);
+	g_free(plain_changes);
+
+	/* Not following on from the previous chunk. */
+	ret = srd_session_send(sess, 0, 64, samples, 64, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	ret = srd_session_send(sess, 64, 128, samples + 64, 64, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	ret = srd_session_send(sess, 1000, 1064, samples + 1000, 64, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	trace_chunk(expected, 0, 128);
+	/* Turning coalescing off decodes what is still held back. */
+	ret = srd_session_coalesce_set(sess, 0, 0);
+	fail_unless(ret == SRD_OK, "srd_session_coalesce_set() failed: %d.",
+			ret);
+	trace_chunk(expected, 1000, 1064);
+	chunks = srdtest_anns_format(anns->str, 0);
+	fail_unless(!strcmp(chunks, expected->str),
+			"Unexpected chunks:\n%s", chunks);
+	g_free(chunks);
+
+	fail_unless(srd_session_coalesce_set(NULL, 1000, 0) != SRD_OK);
+	fail_unless(srd_session_flush(NULL) != SRD_OK);
+
+	srd_session_destroy(sess);
+	srdtest_trace_exit(dir);
+	g_string_free(plain, TRUE);
+	g_string_free(anns, TRUE);
+	g_string_free(expected, TRUE);
+}
+END_TEST
+
+/*
+ * Check whether the glitch filter removes pulses shorter than the width
+ * set for a probe, and keeps those which are long enough, also where the
+ * pulse starts in one chunk and ends in the next. Changes which get
+ * through keep their sample number, however the samples are split into
+ * chunks.
+ * If the decoder sees other changes (or it segfaults) this test will fail.
+ */
+START_TEST(test_session_glitch_filter)
+{
+	static const uint64_t chunk_sizes[] = {100, 37, 3, 1, 400};
+	int ret;
+	unsigned int i;
+	struct srd_session *sess;
+	uint8_t samples[400];
+	GString *anns;
+	char *dir, *changes;
+
+	/* Low pulses on probe 0, which idles high. */
+	memset(samples, 0x01, sizeof(samples));
+	samples[10] = 0x00;
+	memset(samples + 30, 0x00, 2);
+	memset(samples + 50, 0x00, 6);
+	memset(samples + 98, 0x00, 2);
+	/* Across chunks of 100: 2 + 2 samples get through, 2 + 1 don't. */
+	memset(samples + 198, 0x00, 4);
+	memset(samples + 298, 0x00, 3);
+	/* Right up to the end of the capture. */
+	memset(samples + 396, 0x00, 4);
+	/* High pulses on probe 1, which idles low. */
+	samples[20] |= 0x02;
+	samples[40] |= 0x02;
+	samples[41] |= 0x02;
+	samples[150] |= 0x02;
+	samples[151] |= 0x02;
+	samples[152] |= 0x02;
+
+	dir = srdtest_trace_init();
+	for (i = 0; i < G_N_ELEMENTS(chunk_sizes); i++) {
+		anns = g_string_new("");
+		sess = srdtest_session_new("trace", NULL, anns);
+		ret = srd_session_glitch_filter_set(sess, -1, 4);
+		fail_unless(ret == SRD_OK, "srd_session_glitch_filter_set() "
+				"failed: %d.", ret);
+		ret = srd_session_glitch_filter_set(sess, 1, 2);
+		fail_unless(ret == SRD_OK, "srd_session_glitch_filter_set() "
+				"failed: %d.", ret);
+		srdtest_session_start(sess, 1000000);
+		srdtest_send(sess, samples, 400, chunk_sizes[i]);
+		ret = srd_session_flush(sess);
+		fail_unless(ret == SRD_OK, "srd_session_flush() failed: %d.",
+				ret);
+
+		changes = srdtest_anns_format(anns->str, 1);
+		fail_unless(!strcmp(changes,
+				"trace 0-0 1 01\n"
+				"trace 40-40 1 11\n"
+				"trace 42-42 1 01\n"
+				"trace 50-50 1 00\n"
+				"trace 56-56 1 01\n"
+				"trace 150-150 1 11\n"
+				"trace 153-153 1 01\n"
+				"trace 198-198 1 00\n"
+				"trace 202-202 1 01\n"
+				"trace 396-396 1 00\n"),
+				"Unexpected changes in chunks of %" PRIu64
+				":\n%s", chunk_sizes[i], changes);
+		g_free(changes);
+
+		/* Back to the width set for all probes. */
+		ret = srd_session_glitch_filter_set(sess, 1, 0);
+		fail_unless(ret == SRD_OK, "srd_session_glitch_filter_set() "
+				"failed: %d.", ret);
+		ret = srd_session_glitch_filter_set(sess, 9, 2);
+		fail_unless(ret == SRD_OK, "srd_session_glitch_filter_set() "
+				"failed: %d.", ret);
+
+		fail_unless(srd_session_glitch_filter_set(NULL, -1, 4) != SRD_OK);
+		fail_unless(srd_session_glitch_filter_set(sess, -2, 4) != SRD_OK);
+
+		srd_session_destroy(sess);
+		g_string_free(anns, TRUE);
+	}
+
+	srdtest_trace_exit(dir);
+}
+END_TEST
+
+/*
+ * Check whether whole chunks can be passed to a PD's decode_block().
+ * If any call returns != SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_session_send_block)
+{
+	int ret, i;
+	struct srd_session *sess;
+	struct srd_decoder_inst *inst;
+	uint8_t samples[1000];
+	GHashTable *probes;
+
+	for (i = 0; i < 1000; i++)
+		samples[i] = (i / 10) & 1;
+
+	srd_init(NULL);
+	srd_decoder_load("guess_bitrate");
+	srd_session_new(&sess);
+	inst = srd_inst_new(sess, "guess_bitrate", NULL);
+	probes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(probes, "data",
+			g_variant_ref_sink(g_variant_new_int32(0)));
+	srd_inst_probe_set_all(inst, probes);
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(1000000));
+	srd_session_start(sess);
+
+	for (i = 0; i < 10; i++) {
+		ret = srd_session_send(sess, i * 100, (i + 1) * 100,
+				samples + i * 100, 100, 1);
+		fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.",
+				ret);
+	}
+
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
+/*
+ * A PD which puts an annotation over the samples of each decode_block()
+ * call, holding the number of samples it got and the offset of the first
+ * high one among them, or -1.
+ */
+static const char *block_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'blockcheck'\n"
+	"    name = 'Block'\n"
+	"    longname = 'Block check'\n"
+	"    desc = 'Lists the blocks it gets.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['blockcheck']\n"
+	"    probes = [{'id': 'd0', 'name': 'D0', 'desc': ''}]\n"
+	"    annotations = [['block', 'Block']]\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"\n"
+	"    def decode_block(self, ss, es, samples):\n"
+	"        data = samples[0]\n"
+	"        text = '%d %d' % (len(data), data.find(b'\\x01'))\n"
+	"        self.put(ss, es, self.out_ann, [0, [text]])\n";
+
+/*
+ * Check whether long runs are handed to decode_block() in blocks of
+ * bounded size, which together hold all the samples.
+ * If the PD sees other blocks (or it segfaults) this test will fail.
+ */
+START_TEST(test_session_send_block_runs)
+{
+	static const uint64_t samplenums[] = {0, 1500000};
+	static const uint8_t values[] = {0x00, 0x01};
+	struct srd_session *sess;
+	GString *anns;
+	char *dir;
+	int ret;
+
+	dir = srdtest_pd_dir_new("blockcheck", block_pd);
+	srd_init(dir);
+	srd_decoder_load("blockcheck");
+
+	anns = g_string_new("");
+	sess = srdtest_session_new("blockcheck", NULL, anns);
+	srdtest_session_start(sess, 1000000);
+	ret = srd_session_send_events(sess, 0, 2500000, samplenums, values,
+			2, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send_events() failed: %d.",
+			ret);
+	fail_unless(!strcmp(anns->str,
+			"blockcheck 0-1048576 0 1048576 -1\n"
+			"blockcheck 1048576-2097152 0 1048576 451424\n"
+			"blockcheck 2097152-2500000 0 402848 0\n"),
+			"Unexpected blocks:\n%s", anns->str);
+
+	srd_session_destroy(sess);
+	g_string_free(anns, TRUE);
+	srd_exit();
+	srdtest_pd_dir_free(dir, "blockcheck");
+}
+END_TEST
+
+/*
+ * Check whether a raw capture file can be decoded.
+ * If any call returns != SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_session_send_file)
+{
+	int ret;
+	struct srd_session *sess;
+	uint8_t samples[10000];
+	char *path;
+	FILE *f;
+	int fd;
+
+	memset(samples, 0x03, sizeof(samples));
+	fd = g_file_open_tmp("check_session_XXXXXX", &path, NULL);
+	fail_unless(fd >= 0, "Failed to create capture file.");
+	f = fdopen(fd, "wb");
+	fail_unless(f != NULL, "Failed to open capture file.");
+	fwrite(samples, 1, sizeof(samples), f);
+	fclose(f);
+
+	srd_init(NULL);
+	srd_decoder_load("uart");
+	sess = srdtest_session_new("uart", NULL, NULL);
+	srdtest_session_start(sess, 1000000);
+
+	ret = srd_session_send_file(sess, path, 0, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send_file() failed: %d.", ret);
+	ret = srd_session_send_file(sess, path, 1000, 2);
+	fail_unless(ret == SRD_OK, "srd_session_send_file() failed: %d.", ret);
+
+	/* Bogus arguments. */
+	fail_unless(srd_session_send_file(NULL, path, 0, 1) != SRD_OK);
+	fail_unless(srd_session_send_file(sess, NULL, 0, 1) != SRD_OK);
+	fail_unless(srd_session_send_file(sess, path, 0, 0) != SRD_OK);
+	fail_unless(srd_session_send_file(sess, path, 10001, 1) != SRD_OK);
+	remove(path);
+	fail_unless(srd_session_send_file(sess, path, 0, 1) != SRD_OK);
+
+	g_free(path);
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
+/*
+ * Decode the capture with the trace PD, which asks for a pre-roll of 300
+ * samples, in a window from sample 1000 to 2000. The whole capture is
+ * sent in chunks of 250 samples, or from a file. Returns the annotations.
+ */
+static GString *window_run(const uint8_t *samples, const char *path)
+{
+	int ret;
+	struct srd_session *sess;
+	GHashTable *options;
+	GString *anns;
+	uint64_t preroll;
+
+	anns = g_string_new("");
+	options = srdtest_options_new("preroll", g_variant_new_int64(300),
+			NULL);
+	sess = srdtest_session_new("trace", options, anns);
+	g_hash_table_destroy(options);
+	srdtest_session_start(sess, 1000000);
+
+	ret = srd_session_window_set(sess, 1000, 2000);
+	fail_unless(ret == SRD_OK, "srd_session_window_set() failed: %d.",
+			ret);
+	ret = srd_session_preroll_get(sess, &preroll);
+	fail_unless(ret == SRD_OK, "srd_session_preroll_get() failed: %d.",
+			ret);
+	fail_unless(preroll == 300, "Pre-roll is %" PRIu64 ".", preroll);
+
+	if (path) {
+		ret = srd_session_send_file(sess, path, 0, 1);
+		fail_unless(ret == SRD_OK, "srd_session_send_file() "
+				"failed: %d.", ret);
+	} else {
+		srdtest_send(sess, samples, 3000, 250);
+	}
+
+	/* Showing all outputs again. */
+	ret = srd_session_window_set(sess, 0, UINT64_MAX);
+	fail_unless(ret == SRD_OK, "srd_session_window_set() failed: %d.",
+			ret);
+	ret = srd_session_send(sess, 3000, 3200, samples, 200, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+
+	srd_session_destroy(sess);
+
+	return anns;
+}
+
+/*
+ * Check whether annotations which end before the window, or start after
+ * it, are dropped, and whether a file is only decoded from the pre-roll
+ * before the window up to the pre-roll after it.
+ * If other annotations come through (or it segfaults) this test will fail.
+ */
+START_TEST(test_session_window)
+{
+	struct srd_session *sess;
+	uint8_t samples[3000];
+	GString *anns, *expected;
+	char *dir, *path, *changes;
+	uint64_t preroll;
+	FILE *f;
+	int fd, i;
+
+	/* Probe 0 toggles every 100 samples. */
+	for (i = 0; i < 3000; i++)
+		samples[i] = (i / 100) % 2;
+	fd = g_file_open_tmp("check_session_XXXXXX", &path, NULL);
+	fail_unless(fd >= 0, "Failed to create capture file.");
+	f = fdopen(fd, "wb");
+	fail_unless(f != NULL, "Failed to open capture file.");
+	fwrite(samples, 1, sizeof(samples), f);
+	fclose(f);
+
+	expected = g_string_new("");
+	for (i = 1000; i < 2000; i += 100)
+		g_string_append_printf(expected, "trace %d-%d 1 0%d\n", i, i,
+				(i / 100) % 2);
+
+	dir = srdtest_trace_init();
+
+	anns = window_run(samples, NULL);
+	changes = srdtest_anns_format(anns->str, 1);
+	fail_unless(!strncmp(changes, expected->str, expected->len) &&
+			!strcmp(changes + expected->len,
+			"trace 3000-3000 1 00\n"
+			"trace 3100-3100 1 01\n"),
+			"Unexpected changes:\n%s", changes);
+	g_free(changes);
+	/* A chunk ending at the window's start still overlaps it. */
+	changes = srdtest_anns_format(anns->str, 0);
+	fail_unless(!strcmp(changes,
+			"trace 750-1000 0 chunk\n"
+			"trace 1000-1250 0 chunk\n"
+			"trace 1250-1500 0 chunk\n"
+			"trace 1500-1750 0 chunk\n"
+			"trace 1750-2000 0 chunk\n"
+			"trace 3000-3200 0 chunk\n"),
+			"Unexpected chunks:\n%s", changes);
+	g_free(changes);
+	g_string_free(anns, TRUE);
+
+	anns = window_run(samples, path);
+	changes = srdtest_anns_format(anns->str, 1);
+	/* Probe 0 was last seen low at sample 2299, not high at 2999. */
+	fail_unless(!strncmp(changes, expected->str, expected->len) &&
+			!strcmp(changes + expected->len,
+			"trace 3100-3100 1 01\n"),
+			"Unexpected changes:\n%s", changes);
+	g_free(changes);
+	changes = srdtest_anns_format(anns->str, 0);
+	fail_unless(!strcmp(changes,
+			"trace 700-2300 0 chunk\n"
+			"trace 3000-3200 0 chunk\n"),
+			"Unexpected chunks:\n%s", changes);
+	g_free(changes);
+	g_string_free(anns, TRUE);
+
+	sess = srdtest_session_new("trace", NULL, NULL);
+	fail_unless(srd_session_window_set(NULL, 1000, 2000) != SRD_OK);
+	fail_unless(srd_session_window_set(sess, 2000, 1000) != SRD_OK);
+	fail_unless(srd_session_preroll_get(NULL, &preroll) != SRD_OK);
+	fail_unless(srd_session_preroll_get(sess, NULL) != SRD_OK);
+	srd_session_destroy(sess);
+
+	srdtest_trace_exit(dir);
+	g_string_free(expected, TRUE);
+	remove(path);
+	g_free(path);
+}
+END_TEST
+
+/* Send samples start to end as the events at which they change. */
+static void events_send(struct srd_session *sess, const uint8_t *samples,
+		uint64_t start, uint64_t end)
+{
+	uint64_t samplenums[1000], n, num_events;
+	uint8_t values[1000];
+	int ret;
+
+	num_events = 0;
+	for (n = start; n < end; n++) {
+		if (n > 0 && samples[n] == samples[n - 1])
+			continue;
+		samplenums[num_events] = n;
+		values[num_events++] = samples[n];
+	}
+	ret = srd_session_send_events(sess, start, end,
+			num_events ? samplenums : NULL,
+			num_events ? values : NULL, num_events, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send_events() failed: %d.",
+			ret);
+}
+
+/*
+ * Decode the capture with the trace PD, in chunks of 1000 samples. The
+ * first raw_chunks of them are sent as raw samples, the others as events.
+ * Returns the annotations.
+ */
+static char *events_run(const uint8_t *samples, int raw_chunks)
+{
+	struct srd_session *sess;
+	GString *anns;
+	int ret, i;
+
+	anns = g_string_new("");
+	sess = srdtest_session_new("trace", NULL, anns);
+	srdtest_session_start(sess, 1000000);
+	for (i = 0; i < 3; i++) {
+		if (i >= raw_chunks) {
+			events_send(sess, samples, i * 1000, (i + 1) * 1000);
+			continue;
+		}
+		ret = srd_session_send(sess, i * 1000, (i + 1) * 1000,
+				samples + i * 1000, 1000, 1);
+		fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.",
+				ret);
+	}
+	srd_session_destroy(sess);
+
+	return g_string_free(anns, FALSE);
+}
+
+/*
+ * Check whether decoders iterate over changes-only input the same as over
+ * the samples it stands for, also when it follows on from raw samples,
+ * and for a chunk without any changes.
+ * If anything differs (or it segfaults) this test will fail.
+ */
+START_TEST(test_session_send_events)
+{
+	struct srd_session *sess;
+	uint64_t samplenums[] = { 0, 100, 200, 300 };
+	uint64_t unordered[] = { 1200, 1100 };
+	uint8_t values[] = { 0x01, 0x00, 0x01, 0x00 };
+	uint8_t samples[3000];
+	char *dir, *raw, *events, *mixed;
+	uint32_t rnd;
+	int n;
+
+	/* Both probes change at random, and hold still after sample 2000. */
+	rnd = 1;
+	for (n = 0; n < 3000; n++) {
+		rnd = rnd * 1103515245 + 12345;
+		samples[n] = n < 2000 ? (rnd >> 16) % 4 > 0 : samples[1999];
+		if (n < 2000 && (rnd >> 20) % 8 == 0)
+			samples[n] |= 0x02;
+	}
+
+	dir = srdtest_trace_init();
+
+	raw = events_run(samples, 3);
+	events = events_run(samples, 0);
+	mixed = events_run(samples, 1);
+	fail_unless(strstr(raw, "trace 2000-3000 0 chunk") != NULL,
+			"Missing chunk:\n%s", raw);
+	fail_unless(!strcmp(events, raw), "Events differ from samples.");
+	fail_unless(!strcmp(mixed, raw),
+			"Events after samples differ from samples.");
+	g_free(raw);
+	g_free(events);
+	g_free(mixed);
+
+	sess = srdtest_session_new("trace", NULL, NULL);
+	srdtest_session_start(sess, 1000000);
+
+	/* Nothing is known before the first event. */
+	fail_unless(srd_session_send_events(sess, 0, 1000, samplenums + 1,
+			values + 1, 3, 1) != SRD_OK);
+
+	/* Bogus arguments. */
+	fail_unless(srd_session_send_events(NULL, 2000, 3000, samplenums,
+			values, 4, 1) != SRD_OK);
+	fail_unless(srd_session_send_events(sess, 3000, 2000, samplenums,
+			values, 4, 1) != SRD_OK);
+	fail_unless(srd_session_send_events(sess, 2000, 3000, NULL, values,
+			4, 1) != SRD_OK);
+	fail_unless(srd_session_send_events(sess, 2000, 3000, samplenums,
+			values, 4, 0) != SRD_OK);
+	fail_unless(srd_session_send_events(sess, 1000, 2000, unordered,
+			values, 2, 1) != SRD_OK);
+
+	srd_session_destroy(sess);
+	srdtest_trace_exit(dir);
+}
+END_TEST
+
+static uint64_t async_decoded;
+static int async_failed;
+
+/* Runs in the decode thread, so the test checks the counts afterwards. */
+static void async_done(struct srd_session *sess, uint64_t start_samplenum,
+		uint64_t end_samplenum, int ret, void *cb_data)
+{
+	(void)sess;
+	(void)cb_data;
+
+	if (ret != SRD_OK)
+		async_failed++;
+	async_decoded += end_samplenum - start_samplenum;
+}
+
+/*
+ * Check whether chunks can be decoded in the session's own thread, with
+ * each of the queue policies.
+ * If any call returns != SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_session_async)
+{
+	int ret, i, policy;
+	struct srd_session *sess;
+	uint8_t samples[1000];
+
+	memset(samples, 0x03, sizeof(samples));
+
+	srd_init(NULL);
+	srd_decoder_load("uart");
+	sess = srdtest_session_new("uart", NULL, NULL);
+	srdtest_session_start(sess, 1000000);
+
+	for (policy = SRD_ASYNC_BLOCK; policy <= SRD_ASYNC_FAIL; policy++) {
+		async_decoded = 0;
+		async_failed = 0;
+		ret = srd_session_async_set(sess, 4000, policy, async_done,
+				NULL);
+		fail_unless(ret == SRD_OK, "srd_session_async_set() failed: "
+				"%d.", ret);
+		for (i = 0; i < 100; i++) {
+			ret = srd_session_send(sess, i * 1000, (i + 1) * 1000,
+					samples, 1000, 1);
+			fail_unless(ret == SRD_OK || (ret == SRD_ERR_BUSY &&
+					policy == SRD_ASYNC_FAIL),
+					"srd_session_send() failed: %d.", ret);
+		}
+		ret = srd_session_drain(sess);
+		fail_unless(ret == SRD_OK, "srd_session_drain() failed: %d.",
+				ret);
+		fail_unless(async_failed == 0, "Chunks failed to decode.");
+		/* Only blocking gets every chunk decoded. */
+		fail_unless(policy != SRD_ASYNC_BLOCK ||
+				async_decoded == 100000);
+	}
+
+	/* Back to decoding in this thread. */
+	ret = srd_session_async_set(sess, 0, SRD_ASYNC_BLOCK, NULL, NULL);
+	fail_unless(ret == SRD_OK, "srd_session_async_set() failed: %d.", ret);
+	ret = srd_session_send(sess, 100000, 101000, samples, 1000, 1);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	fail_unless(srd_session_drain(sess) == SRD_OK);
+
+	/* Bogus arguments. */
+	fail_unless(srd_session_async_set(NULL, 4000, SRD_ASYNC_BLOCK, NULL,
+			NULL) != SRD_OK);
+	fail_unless(srd_session_async_set(sess, 4000, -1, NULL, NULL)
+			!= SRD_OK);
+	fail_unless(srd_session_drain(NULL) != SRD_OK);
+
+	/* Destroying the session ends the decode thread. */
+	srd_session_async_set(sess, 4000, SRD_ASYNC_BLOCK, NULL, NULL);
+	srd_session_send(sess, 101000, 102000, samples, 1000, 1);
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
+static void async_annotation(struct srd_proto_data *pdata, void *cb_data)
+{
+	(void)pdata;
+	(void)cb_data;
+}
+
+/*
+ * Check whether decoders can be loaded, and instances set up, while a
+ * session decodes in a thread of its own.
+ * If any call returns != SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_session_async_setup)
+{
+	int ret, i;
+	struct srd_session *sess;
+	struct srd_decoder_inst *di;
+	GHashTable *options;
+	uint8_t samples[1000];
+	char *doc;
+
+	memset(samples, 0x03, sizeof(samples));
+
+	srd_init(NULL);
+	srd_decoder_load("uart");
+	sess = srdtest_session_new("uart", NULL, NULL);
+	srdtest_session_start(sess, 1000000);
+	ret = srd_session_async_set(sess, 4000, SRD_ASYNC_BLOCK, NULL, NULL);
+	fail_unless(ret == SRD_OK, "srd_session_async_set() failed: %d.", ret);
+	for (i = 0; i < 10; i++)
+		srd_session_send(sess, i * 1000, (i + 1) * 1000, samples,
+				1000, 1);
+
+	/* The decode thread may still be busy with the chunks. */
+	ret = srd_decoder_load("spi");
+	fail_unless(ret == SRD_OK, "srd_decoder_load() failed: %d.", ret);
+	doc = srd_decoder_doc_get(srd_decoder_get_by_id("spi"));
+	fail_unless(doc != NULL, "srd_decoder_doc_get() failed.");
+	g_free(doc);
+	options = srdtest_options_new("wordsize", g_variant_new_int64(16),
+			NULL);
+	di = srd_inst_new(sess, "spi", options);
+	fail_unless(di != NULL, "srd_inst_new() failed.");
+	ret = srd_inst_option_set(di, options);
+	fail_unless(ret == SRD_OK, "srd_inst_option_set() failed: %d.", ret);
+	g_hash_table_destroy(options);
+	ret = srd_inst_decimation_set(di, 4, SRD_DECIMATE_MAJORITY);
+	fail_unless(ret == SRD_OK, "srd_inst_decimation_set() failed: %d.",
+			ret);
+	ret = srd_pd_output_callback_add(sess, SRD_OUTPUT_ANN,
+			async_annotation, NULL);
+	fail_unless(ret == SRD_OK, "srd_pd_output_callback_add() failed: %d.",
+			ret);
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(1000000));
+	ret = srd_session_start(sess);
+	fail_unless(ret == SRD_OK, "srd_session_start() failed: %d.", ret);
+
+	for (i = 0; i < 10; i++)
+		srd_session_send(sess, i * 1000, (i + 1) * 1000, samples,
+				1000, 1);
+	ret = srd_session_drain(sess);
+	fail_unless(ret == SRD_OK, "srd_session_drain() failed: %d.", ret);
+
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
+#ifdef HAVE_SHM_OPEN
+/*
+ * Check whether samples can be decoded from a shared memory ring, with the
+ * test acting as the producer.
+ * If any call returns != SRD_OK (or segfaults) this test will fail.
+ */
+START_TEST(test_session_shm)
+{
+	int ret, i, fd, closed;
+	struct srd_session *sess;
+	struct srd_shm_ring *ring;
+	uint8_t samples[3000];
+	uint64_t len, written;
+	char name[32];
+
+	memset(samples, 0x03, sizeof(samples));
+	len = 4096 + 10000;
+
+	snprintf(name, sizeof(name), "/check_session_%d", (int)getpid());
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	fail_unless(fd >= 0, "Failed to create shared memory.");
+	fail_unless(ftruncate(fd, len) == 0);
+	ring = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	fail_unless(ring != MAP_FAILED, "Failed to map shared memory.");
+	close(fd);
+	srd_shm_ring_init(ring, 4096, 10000, 1, 1000000);
+
+	srd_init(NULL);
+	srd_decoder_load("uart");
+	sess = srdtest_session_new("uart", NULL, NULL);
+	srd_session_start(sess);
+
+	ret = srd_session_shm_attach(sess, name);
+	fail_unless(ret == SRD_OK, "srd_session_shm_attach() failed: %d.",
+			ret);
+
+	/* Ten times round the ring, mostly not lined up with its end. */
+	for (i = 0; i < 33; i++) {
+		written = srd_shm_ring_write(ring, samples, sizeof(samples));
+		fail_unless(written == sizeof(samples),
+				"Ring is full after %d chunks.", i);
+		ret = srd_session_shm_decode(sess, &closed);
+		fail_unless(ret == SRD_OK, "srd_session_shm_decode() "
+				"failed: %d.", ret);
+		fail_unless(!closed, "Ring is closed.");
+		fail_unless(ring->tail == ring->head,
+				"Samples were not handed back.");
+	}
+
+	/* A full ring only takes what fits. */
+	written = srd_shm_ring_write(ring, samples, sizeof(samples));
+	written += srd_shm_ring_write(ring, samples, sizeof(samples));
+	written += srd_shm_ring_write(ring, samples, sizeof(samples));
+	written += srd_shm_ring_write(ring, samples, sizeof(samples));
+	fail_unless(written == 10000, "Ring took %" PRIu64 " bytes.",
+			written);
+
+	srd_shm_ring_close(ring);
+	ret = srd_session_shm_decode(sess, &closed);
+	fail_unless(ret == SRD_OK, "srd_session_shm_decode() failed: %d.",
+			ret);
+	fail_unless(closed, "Ring is not closed.");
+
+	/* Bogus arguments. */
+	fail_unless(srd_session_shm_attach(NULL, name) != SRD_OK);
+	fail_unless(srd_session_shm_attach(sess, NULL) != SRD_OK);
+	fail_unless(srd_session_shm_attach(sess, "/check_session_none")
+			!= SRD_OK);
+	fail_unless(srd_session_shm_decode(sess, NULL) != SRD_OK);
+	fail_unless(srd_session_shm_detach(NULL) != SRD_OK);
+
+	/* A producer running wild is caught. */
+	srd_session_shm_attach(sess, name);
+	ring->head += 20000;
+	fail_unless(srd_session_shm_decode(sess, NULL) != SRD_OK);
+
+	srd_session_destroy(sess);
+	srd_exit();
+	munmap(ring, len);
+	shm_unlink(name);
+}
+END_TEST
+#endif
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -255,5 +1179,23 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_metadata_set_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("send");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_session_send);
+	tcase_add_test(tc, test_session_send_bogus);
+	tcase_add_test(tc, test_session_send_block);
+	tcase_add_test(tc, test_session_send_block_runs);
+	tcase_add_test(tc, test_session_send_file);
+	tcase_add_test(tc, test_session_window);
+	tcase_add_test(tc, test_session_send_events);
+	tcase_add_test(tc, test_session_async);
+	tcase_add_test(tc, test_session_async_setup);
+#ifdef HAVE_SHM_OPEN
+	tcase_add_test(tc, test_session_shm);
+#endif
+	tcase_add_test(tc, test_session_coalesce);
+	tcase_add_test(tc, test_session_glitch_filter);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,232 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
+#include "../libsigrokdecode-internal.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+/*
+ * The kernels are static, and the library's symbols hidden, so the unpack
+ * code is built into the tests as well. Its logging goes nowhere.
+ */
+#define srd_dbg(...) ((void)0)
+#include "../unpack.c"
+
+#define MAX_UNITSIZE 9
+#define MAX_SAMPLES 1001
+#define MAX_WORDS ((MAX_SAMPLES + 63) / 64)
+/* Fills the planes beforehand, to see which words were written. */
+#define CANARY 0x5aa5c33cf00f9669ULL
+
+static const struct {
+	const char *name;
+	transpose_func func;
+} kernels[] = {
+	{"scalar", transpose_scalar},
+#ifdef SRD_UNPACK_X86
+	{"sse2", transpose_sse2},
+	{"avx2", transpose_avx2},
+#endif
+};
+
+static void setup(void)
+{
+	/* Silence libsigrokdecode while the unit tests run. */
+	srd_log_loglevel_set(SRD_LOG_NONE);
+}
+
+static void teardown(void)
+{
+	/* Let srd_unpack_planes() pick the kernel itself again. */
+	transpose = NULL;
+}
+
+static gboolean kernel_supported(const char *name)
+{
+#ifdef SRD_UNPACK_X86
+	__builtin_cpu_init();
+	if (!strcmp(name, "sse2"))
+		return __builtin_cpu_supports("sse2");
+	if (!strcmp(name, "avx2"))
+		return __builtin_cpu_supports("avx2");
+#endif
+
+	return !strcmp(name, "scalar");
+}
+
+static void random_fill(GRand *rand, uint8_t *buf, uint64_t len)
+{
+	uint64_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = g_rand_int(rand);
+}
+
+/* The value of a probe in a sample, the slow way. */
+static int naive_bit(const uint8_t *inbuf, int unitsize, uint64_t n,
+		int probe)
+{
+	return (inbuf[n * unitsize + probe / 8] >> (probe % 8)) & 1;
+}
+
+/*
+ * Check whether each transpose kernel turns 64 random bytes into the
+ * 8 plane words they hold.
+ * If any bit is off this test will fail.
+ */
+START_TEST(test_unpack_transpose)
+{
+	GRand *rand;
+	uint8_t bytes[64];
+	uint64_t words[8];
+	unsigned int k;
+	int round, i, b;
+
+	rand = g_rand_new_with_seed(1);
+	for (k = 0; k < G_N_ELEMENTS(kernels); k++) {
+		if (!kernel_supported(kernels[k].name))
+			continue;
+		for (round = 0; round < 100; round++) {
+			random_fill(rand, bytes, sizeof(bytes));
+			kernels[k].func(bytes, words);
+			for (i = 0; i < 64; i++) {
+				for (b = 0; b < 8; b++) {
+					fail_unless(((words[b] >> i) & 1) ==
+						(uint64_t)((bytes[i] >> b) & 1),
+						"%s kernel: bit %d of byte %d "
+						"is wrong.", kernels[k].name,
+						b, i);
+				}
+			}
+		}
+	}
+	g_rand_free(rand);
+}
+END_TEST
+
+/*
+ * Unpack random samples with the given kernel, unitsize and lane masks,
+ * and check every plane against the samples. Planes of probes not in the
+ * masks must be left alone, and the bits after the last sample be 0.
+ */
+static void unpack_check(GRand *rand, const char *kernel, int unitsize,
+		uint64_t num_samples, const uint8_t *lane_masks)
+{
+	static uint64_t plane_buf[MAX_UNITSIZE * 8][MAX_WORDS + 1];
+	uint64_t *planes[MAX_UNITSIZE * 8], words, n, w;
+	uint8_t *inbuf;
+	int probe, used;
+
+	inbuf = g_malloc(num_samples * unitsize);
+	random_fill(rand, inbuf, num_samples * unitsize);
+	words = (num_samples + 63) / 64;
+	for (probe = 0; probe < unitsize * 8; probe++) {
+		for (w = 0; w <= words; w++)
+			plane_buf[probe][w] = CANARY;
+		planes[probe] = plane_buf[probe];
+	}
+
+	srd_unpack_planes(planes, inbuf, num_samples, unitsize, lane_masks);
+
+	for (probe = 0; probe < unitsize * 8; probe++) {
+		used = lane_masks[probe / 8] & (1 << (probe % 8));
+		for (w = 0; w < words; w++) {
+			fail_unless(used || planes[probe][w] == CANARY,
+					"%s kernel, unitsize %d, %" PRIu64
+					" samples: unused probe %d was "
+					"written.", kernel, unitsize,
+					num_samples, probe);
+		}
+		fail_unless(planes[probe][words] == CANARY,
+				"%s kernel, unitsize %d, %" PRIu64 " samples: "
+				"probe %d was written past its end.", kernel,
+				unitsize, num_samples, probe);
+		if (!used)
+			continue;
+		for (n = 0; n < words * 64; n++) {
+			fail_unless(((planes[probe][n / 64] >> (n % 64)) & 1) ==
+				(uint64_t)(n < num_samples ?
+				naive_bit(inbuf, unitsize, n, probe) : 0),
+				"%s kernel, unitsize %d, %" PRIu64 " samples: "
+				"probe %d is wrong at sample %" PRIu64 ".",
+				kernel, unitsize, num_samples, probe, n);
+		}
+	}
+	g_free(inbuf);
+}
+
+/*
+ * Check whether srd_unpack_planes() unpacks random samples of various
+ * sizes, in chunks which mostly don't end on a block of 64 samples, with
+ * each of the kernels.
+ * If any bit is off (or it segfaults) this test will fail.
+ */
+START_TEST(test_unpack_planes)
+{
+	const int unitsizes[] = { 1, 2, 3, 4, 8, MAX_UNITSIZE };
+	const uint64_t sample_counts[] = { 1, 7, 63, 64, 65, 127, 200,
+			MAX_SAMPLES };
+	uint8_t all[MAX_UNITSIZE], some[MAX_UNITSIZE];
+	GRand *rand;
+	unsigned int k, u, c;
+	int i;
+
+	memset(all, 0xff, sizeof(all));
+	/* Skip some probes in every lane, and all of some lanes. */
+	for (i = 0; i < MAX_UNITSIZE; i++)
+		some[i] = i % 3 == 1 ? 0 : 0x5a >> (i % 2);
+
+	rand = g_rand_new_with_seed(2);
+	for (k = 0; k < G_N_ELEMENTS(kernels); k++) {
+		if (!kernel_supported(kernels[k].name))
+			continue;
+		transpose = kernels[k].func;
+		for (u = 0; u < G_N_ELEMENTS(unitsizes); u++) {
+			for (c = 0; c < G_N_ELEMENTS(sample_counts); c++) {
+				unpack_check(rand, kernels[k].name,
+						unitsizes[u], sample_counts[c],
+						all);
+				unpack_check(rand, kernels[k].name,
+						unitsizes[u], sample_counts[c],
+						some);
+			}
+		}
+	}
+	g_rand_free(rand);
+	transpose = NULL;
+}
+END_TEST
+
+Suite *suite_unpack(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("unpack");
+
+	tc = tcase_create("planes");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_unpack_transpose);
+	tcase_add_test(tc, test_unpack_planes);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,250 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Helpers shared by the unit tests, for setting up sessions and seeing
+ * what the decoders in them put().
+ */
+
+#include "../libsigrokdecode.h" /* First, to avoid compiler warning. */
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "lib.h"
+
+/*
+ * A PD which puts a "chunk" annotation over the samples of each decode()
+ * call, and a "change" annotation at each sample where its probes differ
+ * from the sample before, holding their values as "<d1><d0>".
+ */
+static const char *trace_pd =
+	"import sigrokdecode as srd\n"
+	"\n"
+	"class Decoder(srd.Decoder):\n"
+	"    api_version = 1\n"
+	"    id = 'trace'\n"
+	"    name = 'Trace'\n"
+	"    longname = 'Trace'\n"
+	"    desc = 'Lists the chunks and the changes it gets.'\n"
+	"    license = 'gplv2+'\n"
+	"    inputs = ['logic']\n"
+	"    outputs = ['trace']\n"
+	"    probes = [\n"
+	"        {'id': 'd0', 'name': 'D0', 'desc': ''},\n"
+	"        {'id': 'd1', 'name': 'D1', 'desc': ''},\n"
+	"    ]\n"
+	"    options = {\n"
+	"        'preroll': ['Pre-roll in samples', 0],\n"
+	"    }\n"
+	"    annotations = [['chunk', 'Chunk'], ['change', 'Change']]\n"
+	"\n"
+	"    def __init__(self):\n"
+	"        self.prev = None\n"
+	"\n"
+	"    def start(self):\n"
+	"        self.out_ann = self.register(srd.OUTPUT_ANN)\n"
+	"        self.preroll = self.options['preroll']\n"
+	"\n"
+	"    def decode(self, ss, es, data):\n"
+	"        self.put(ss, es, self.out_ann, [0, ['chunk']])\n"
+	"        for samplenum, pins in data:\n"
+	"            if pins != self.prev:\n"
+	"                value = '%d%d' % (pins[1], pins[0])\n"
+	"                self.put(samplenum, samplenum, self.out_ann,\n"
+	"                         [1, [value]])\n"
+	"            self.prev = pins\n";
+
+/*
+ * Create a hash of instance options, from pairs of a key and a GVariant
+ * value, ending with a NULL key. Floating values are sunk.
+ */
+GHashTable *srdtest_options_new(const char *key, ...)
+{
+	GHashTable *options;
+	GVariant *value;
+	va_list args;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	va_start(args, key);
+	for (; key; key = va_arg(args, const char *)) {
+		value = va_arg(args, GVariant *);
+		g_hash_table_insert(options, (char *)key,
+				g_variant_ref_sink(value));
+	}
+	va_end(args);
+
+	return options;
+}
+
+/*
+ * Write a PD into a directory of its own, to be passed to srd_init().
+ * Returns the directory, for srdtest_pd_dir_free().
+ */
+char *srdtest_pd_dir_new(const char *id, const char *code)
+{
+	char *dir, *pd_dir, *pd_file;
+
+	/* Nothing but the PD itself is left to clean up afterwards. */
+	g_setenv("PYTHONDONTWRITEBYTECODE", "1", TRUE);
+
+	dir = g_dir_make_tmp("srd-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create PD directory.");
+	pd_dir = g_build_filename(dir, id, NULL);
+	pd_file = g_build_filename(pd_dir, "__init__.py", NULL);
+	fail_unless(g_mkdir(pd_dir, 0700) == 0 &&
+			g_file_set_contents(pd_file, code, -1, NULL),
+			"Failed to write PD %s.", id);
+	g_free(pd_file);
+	g_free(pd_dir);
+
+	return dir;
+}
+
+/* Remove a PD written by srdtest_pd_dir_new(), and free the path. */
+void srdtest_pd_dir_free(char *dir, const char *id)
+{
+	char *pd_dir, *pd_file;
+
+	pd_dir = g_build_filename(dir, id, NULL);
+	pd_file = g_build_filename(pd_dir, "__init__.py", NULL);
+	g_remove(pd_file);
+	g_rmdir(pd_dir);
+	g_rmdir(dir);
+	g_free(pd_file);
+	g_free(pd_dir);
+	g_free(dir);
+}
+
+/* Append each annotation as a line of "inst start-end format text". */
+static void srdtest_ann_cb(struct srd_proto_data *pdata, void *cb_data)
+{
+	struct srd_proto_data_annotation *pda;
+
+	pda = pdata->data;
+	g_string_append_printf(cb_data, "%s %" PRIu64 "-%" PRIu64 " %d %s\n",
+			pdata->pdo->di->inst_id, pdata->start_sample,
+			pdata->end_sample, pda->ann_format, pda->ann_text[0]);
+}
+
+/*
+ * Create a session holding an instance of the given decoder, with the
+ * given options or the defaults if NULL. If anns isn't NULL, all
+ * annotations put() in the session get appended to it.
+ */
+struct srd_session *srdtest_session_new(const char *decoder_id,
+		GHashTable *options, GString *anns)
+{
+	struct srd_session *sess;
+	GHashTable *defaults;
+	int ret;
+
+	ret = srd_session_new(&sess);
+	fail_unless(ret == SRD_OK, "srd_session_new() failed: %d.", ret);
+	defaults = g_hash_table_new(g_str_hash, g_str_equal);
+	fail_unless(srd_inst_new(sess, decoder_id,
+			options ? options : defaults) != NULL,
+			"srd_inst_new(%s) failed.", decoder_id);
+	g_hash_table_destroy(defaults);
+	if (anns) {
+		ret = srd_pd_output_callback_add(sess, SRD_OUTPUT_ANN,
+				srdtest_ann_cb, anns);
+		fail_unless(ret == SRD_OK, "srd_pd_output_callback_add() "
+				"failed: %d.", ret);
+	}
+
+	return sess;
+}
+
+/* Pass the samplerate to the session, and start it. */
+void srdtest_session_start(struct srd_session *sess, uint64_t samplerate)
+{
+	int ret;
+
+	ret = srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(samplerate));
+	fail_unless(ret == SRD_OK, "srd_session_metadata_set() failed: %d.",
+			ret);
+	ret = srd_session_start(sess);
+	fail_unless(ret == SRD_OK, "srd_session_start() failed: %d.", ret);
+}
+
+/*
+ * Set up libsigrokdecode with the "trace" PD loaded. Returns the PD's
+ * directory, for srdtest_trace_exit().
+ */
+char *srdtest_trace_init(void)
+{
+	char *dir;
+	int ret;
+
+	dir = srdtest_pd_dir_new("trace", trace_pd);
+	ret = srd_init(dir);
+	fail_unless(ret == SRD_OK, "srd_init() failed: %d.", ret);
+	ret = srd_decoder_load("trace");
+	fail_unless(ret == SRD_OK, "srd_decoder_load() failed: %d.", ret);
+
+	return dir;
+}
+
+/* Shut libsigrokdecode down, and remove the "trace" PD. */
+void srdtest_trace_exit(char *dir)
+{
+	srd_exit();
+	srdtest_pd_dir_free(dir, "trace");
+}
+
+/* Send samples of one byte each, in chunks of chunk_samples. */
+void srdtest_send(struct srd_session *sess, const uint8_t *samples,
+		uint64_t num_samples, uint64_t chunk_samples)
+{
+	uint64_t start, end;
+	int ret;
+
+	for (start = 0; start < num_samples; start = end) {
+		end = MIN(start + chunk_samples, num_samples);
+		ret = srd_session_send(sess, start, end, samples + start,
+				end - start, 1);
+		fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.",
+				ret);
+	}
+}
+
+/*
+ * Return the lines of annotations appended by srdtest_session_new()
+ * which have the given annotation format. Free with g_free().
+ */
+char *srdtest_anns_format(const char *anns, int ann_format)
+{
+	GString *out;
+	const char *end;
+	int format;
+
+	out = g_string_new("");
+	for (; *anns; anns = end + 1) {
+		end = strchr(anns, '\n');
+		if (sscanf(anns, "%*s %*s %d", &format) == 1 &&
+				format == ann_format)
+			g_string_append_len(out, anns, end + 1 - anns);
+	}
+
+	return g_string_free(out, FALSE);
+}
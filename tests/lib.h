@@ -0,0 +1,37 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef LIBSIGROKDECODE_TESTS_LIB_H
+#define LIBSIGROKDECODE_TESTS_LIB_H
+
+#include <glib.h>
+#include <stdint.h>
+
+GHashTable *srdtest_options_new(const char *key, ...);
+char *srdtest_pd_dir_new(const char *id, const char *code);
+void srdtest_pd_dir_free(char *dir, const char *id);
+struct srd_session *srdtest_session_new(const char *decoder_id,
+		GHashTable *options, GString *anns);
+void srdtest_session_start(struct srd_session *sess, uint64_t samplerate);
+char *srdtest_trace_init(void);
+void srdtest_trace_exit(char *dir);
+void srdtest_send(struct srd_session *sess, const uint8_t *samples,
+		uint64_t num_samples, uint64_t chunk_samples);
+char *srdtest_anns_format(const char *anns, int ann_format);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Example producer for the shared memory ring, standing in for an
+ * acquisition program.
+ *
+ * Creates a ring, streams a raw capture file into it a block at a time,
+ * and waits for the consumer to decode everything before removing the
+ * ring again. Start it first, then attach a session to the same name with
+ * srd_session_shm_attach() and call srd_session_shm_decode() until the
+ * ring is closed.
+ *
+ * Only needs shm_ring.h, not the rest of libsigrokdecode. Build with
+ * 'make shm_producer' in the tests directory.
+ */
+
+#include "../shm_ring.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define DATA_OFFSET 4096
+#define RING_SIZE (1024 * 1024)
+#define BLOCK_SIZE (64 * 1024)
+
+int main(int argc, char **argv)
+{
+	struct srd_shm_ring *ring;
+	FILE *f;
+	uint8_t *block;
+	uint64_t unitsize, samplerate, size, len, done;
+	int fd;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s NAME FILE [UNITSIZE [SAMPLERATE]]\n",
+				argv[0]);
+		return 1;
+	}
+	unitsize = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+	samplerate = argc > 4 ? strtoull(argv[4], NULL, 10) : 0;
+	if (unitsize == 0 || unitsize > BLOCK_SIZE) {
+		fprintf(stderr, "Invalid unitsize.\n");
+		return 1;
+	}
+
+	if (!(f = fopen(argv[2], "rb"))) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	size = RING_SIZE - RING_SIZE % unitsize;
+	if ((fd = shm_open(argv[1], O_RDWR | O_CREAT | O_EXCL, 0600)) < 0 ||
+			ftruncate(fd, DATA_OFFSET + size) < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+	ring = mmap(NULL, DATA_OFFSET + size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		perror("mmap");
+		shm_unlink(argv[1]);
+		return 1;
+	}
+	srd_shm_ring_init(ring, DATA_OFFSET, size, unitsize, samplerate);
+
+	/* Whole samples only, so nothing is left over between blocks. */
+	block = malloc(BLOCK_SIZE);
+	while ((len = fread(block, 1, BLOCK_SIZE - BLOCK_SIZE % unitsize,
+			f)) > 0) {
+		len -= len % unitsize;
+		for (done = 0; done < len; ) {
+			done += srd_shm_ring_write(ring, block + done,
+					len - done);
+			if (done < len)
+				usleep(1000);
+		}
+	}
+	srd_shm_ring_close(ring);
+	fclose(f);
+	free(block);
+
+	while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head)
+		usleep(10000);
+	printf("%llu bytes decoded.\n", (unsigned long long)ring->head);
+
+	munmap(ring, DATA_OFFSET + size);
+	shm_unlink(argv[1]);
+
+	return 0;
+}
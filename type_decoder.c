@@ -191,23 +191,74 @@ static int convert_meta(struct srd_proto_data *pdata, PyObject *obj)
 	return SRD_OK;
 }
 
+#if PY_VERSION_HEX >= 0x03070000
+/* Convert a sample number the way the "K" format of PyArg_ParseTuple() does. */
+static int put_arg_samplenum(PyObject *py_arg, uint64_t *samplenum)
+{
+	if (!PyLong_Check(py_arg)) {
+		PyErr_Format(PyExc_TypeError, "put() sample number must be "
+				"int, not %s", Py_TYPE(py_arg)->tp_name);
+		return -1;
+	}
+	*samplenum = PyLong_AsUnsignedLongLongMask(py_arg);
+
+	return PyErr_Occurred() ? -1 : 0;
+}
+
+/* And an output ID the way the "i" format does. */
+static int put_arg_output_id(PyObject *py_arg, int *output_id)
+{
+	long val;
+
+	val = PyLong_AsLong(py_arg);
+	if (val == -1 && PyErr_Occurred())
+		return -1;
+	if (val < INT_MIN || val > INT_MAX) {
+		PyErr_SetString(PyExc_OverflowError, "put() output ID out of "
+				"range");
+		return -1;
+	}
+	*output_id = val;
+
+	return 0;
+}
+
+/* Called with METH_FASTCALL, without building an argument tuple. */
+static PyObject *Decoder_put(PyObject *self, PyObject *const *args,
+		Py_ssize_t nargs)
+#else
 static PyObject *Decoder_put(PyObject *self, PyObject *args)
+#endif
 {
 	GSList *l;
-	PyObject *py_data, *py_res;
+	PyObject *py_data, *py_res, *py_packet;
 	struct srd_decoder_inst *di, *next_di;
 	struct srd_pd_output *pdo;
 	struct srd_proto_data *pdata;
 	uint64_t start_sample, end_sample;
 	int output_id;
+	gboolean shown;
 	struct srd_pd_callback *cb;
 
-	if (!(di = srd_inst_find_by_obj(NULL, self))) {
+	if (!(di = ((srd_Decoder *)self)->di)) {
 		/* Shouldn't happen. */
 		srd_dbg("put(): self instance not found.");
 		return NULL;
 	}
 
+#if PY_VERSION_HEX >= 0x03070000
+	if (nargs != 4) {
+		PyErr_Format(PyExc_TypeError, "put() takes exactly 4 "
+				"arguments (%zd given)", nargs);
+		return NULL;
+	}
+	if (put_arg_samplenum(args[0], &start_sample) < 0 ||
+	    put_arg_samplenum(args[1], &end_sample) < 0)
+		return NULL;
+	if (put_arg_output_id(args[2], &output_id) < 0)
+		return NULL;
+	py_data = args[3];
+#else
 	if (!PyArg_ParseTuple(args, "KKiO", &start_sample, &end_sample,
 	    &output_id, &py_data)) {
 		/*
@@ -217,6 +268,7 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 		 */
 		return NULL;
 	}
+#endif
 
 	if (!(l = g_slist_nth(di->pd_output, output_id))) {
 		srd_err("Protocol decoder %s submitted invalid output ID %d.",
@@ -225,6 +277,12 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 	}
 	pdo = l->data;
 
+	/* Back to sample numbers of the capture. */
+	if (di->decim) {
+		start_sample *= di->decim->factor;
+		end_sample *= di->decim->factor;
+	}
+
 	srd_spew("Instance %s put %" PRIu64 "-%" PRIu64 " %s on oid %d.",
 		 di->inst_id, start_sample, end_sample,
 		 OUTPUT_TYPES[pdo->output_type], output_id);
@@ -237,10 +295,15 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 	pdata->end_sample = end_sample;
 	pdata->pdo = pdo;
 
+	/* Outputs outside the window the frontend shows are dropped. */
+	shown = end_sample >= di->sess->window_start &&
+			start_sample < di->sess->window_end;
+
 	switch (pdo->output_type) {
 	case SRD_OUTPUT_ANN:
 		/* Annotations are only fed to callbacks. */
-		if ((cb = srd_pd_output_callback_find(di->sess, pdo->output_type))) {
+		if (shown && (cb = srd_pd_output_callback_find(di->sess,
+				pdo->output_type))) {
 			/* Convert from PyDict to srd_proto_data_annotation. */
 			if (convert_annotation(di, py_data, pdata) != SRD_OK) {
 				/* An error was already logged. */
@@ -250,16 +313,33 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 		}
 		break;
 	case SRD_OUTPUT_PYTHON:
-		for (l = di->next_di; l; l = l->next) {
+		/* Only the instances taking this stream. */
+		for (l = pdo->next_di; l; l = l->next) {
 			next_di = l->data;
-			/* TODO: Is this needed? */
-			Py_XINCREF(next_di->py_inst);
-			srd_spew("Sending %d-%d to instance %s",
-				 start_sample, end_sample,
+			if (next_di->decode_batch) {
+				/* Handed over at the end of the chunk. */
+				if (!next_di->py_batch &&
+				    !(next_di->py_batch = PyList_New(0))) {
+					srd_exception_catch("Failed to create "
+							"batch: ");
+					continue;
+				}
+				if (!(py_packet = Py_BuildValue("(KKO)",
+				    start_sample, end_sample, py_data)) ||
+				    PyList_Append(next_di->py_batch,
+				    py_packet) < 0) {
+					srd_exception_catch("Failed to queue "
+							"packet for %s: ",
+							next_di->inst_id);
+				}
+				Py_XDECREF(py_packet);
+				continue;
+			}
+			srd_spew("Sending %" PRIu64 "-%" PRIu64 " to "
+				 "instance %s", start_sample, end_sample,
 				 next_di->inst_id);
-			if (!(py_res = PyObject_CallMethod(
-			    next_di->py_inst, "decode", "KKO", start_sample,
-			    end_sample, py_data))) {
+			if (!(py_res = srd_inst_call_decode(next_di,
+			    start_sample, end_sample, py_data))) {
 				srd_exception_catch("Calling %s decode(): ",
 						    next_di->inst_id);
 			}
@@ -267,7 +347,8 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 		}
 		break;
 	case SRD_OUTPUT_BINARY:
-		if ((cb = srd_pd_output_callback_find(di->sess, pdo->output_type))) {
+		if (shown && (cb = srd_pd_output_callback_find(di->sess,
+				pdo->output_type))) {
 			/* Convert from PyDict to srd_proto_data_binary. */
 			if (convert_binary(di, py_data, pdata) != SRD_OK) {
 				/* An error was already logged. */
@@ -277,7 +358,8 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 		}
 		break;
 	case SRD_OUTPUT_META:
-		if ((cb = srd_pd_output_callback_find(di->sess, pdo->output_type))) {
+		if (shown && (cb = srd_pd_output_callback_find(di->sess,
+				pdo->output_type))) {
 			/* Annotations need converting from PyObject. */
 			if (convert_meta(pdata, py_data) != SRD_OK) {
 				/* An exception was already set up. */
@@ -304,6 +386,7 @@ static PyObject *Decoder_register(PyObject *self, PyObject *args,
 	struct srd_pd_output *pdo;
 	PyObject *py_new_output_id;
 	PyTypeObject *meta_type_py;
+	GSList *l;
 	const GVariantType *meta_type_gv;
 	int output_type;
 	char *proto_id, *meta_name, *meta_descr;
@@ -313,7 +396,7 @@ static PyObject *Decoder_register(PyObject *self, PyObject *args,
 	meta_type_gv = NULL;
 	meta_name = meta_descr = NULL;
 
-	if (!(di = srd_inst_find_by_obj(NULL, self))) {
+	if (!(di = ((srd_Decoder *)self)->di)) {
 		PyErr_SetString(PyExc_Exception, "decoder instance not found");
 		return NULL;
 	}
@@ -353,6 +436,11 @@ static PyObject *Decoder_register(PyObject *self, PyObject *args,
 	pdo->output_type = output_type;
 	pdo->di = di;
 	pdo->proto_id = g_strdup(proto_id);
+	pdo->next_di = NULL;
+	for (l = di->next_di; l; l = l->next) {
+		if (srd_inst_takes_output(l->data, pdo))
+			pdo->next_di = g_slist_append(pdo->next_di, l->data);
+	}
 
 	if (output_type == SRD_OUTPUT_META) {
 		pdo->meta_type = meta_type_gv;
@@ -380,8 +468,13 @@ static PyObject *Decoder_add(PyObject *self, PyObject *args)
 }
 
 static PyMethodDef Decoder_methods[] = {
+#if PY_VERSION_HEX >= 0x03070000
+	{"put", (PyCFunction)(void (*)(void))Decoder_put, METH_FASTCALL,
+	 "Accepts a dictionary with the following keys: startsample, endsample, data"},
+#else
 	{"put", Decoder_put, METH_VARARGS,
 	 "Accepts a dictionary with the following keys: startsample, endsample, data"},
+#endif
 	{"add", Decoder_add, METH_VARARGS, "Create a new output stream"},
 	{"register", (PyCFunction)Decoder_register, METH_VARARGS|METH_KEYWORDS,
 			"Register a new output stream"},
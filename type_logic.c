@@ -18,53 +18,213 @@
  */
 
 #include "libsigrokdecode.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include "libsigrokdecode-internal.h"
 #include "config.h"
 #include <inttypes.h>
 #include <string.h>
 
 static PyObject *srd_logic_iter(PyObject *self)
 {
+	Py_INCREF(self);
+
 	return self;
 }
 
-static PyObject *srd_logic_iternext(PyObject *self)
+/*
+ * Move to sample n of the chunk. For run-length encoded chunks, this also
+ * finds the run holding that sample; samples only ever move forward.
+ */
+static void logic_seek(srd_logic *logic, uint64_t n)
 {
-	srd_logic *logic;
-	PyObject *py_samplenum, *py_samples;
-	uint8_t *sample_pos, sample;
-	int byte_offset, bit_offset, i;
+	const struct srd_chunk *chunk;
 
-	logic = (srd_logic *)self;
-	if (logic->itercnt >= logic->inbuflen / logic->di->data_unitsize) {
-		/* End iteration loop. */
-		return NULL;
-	}
+	chunk = logic->chunk;
+	logic->itercnt = n;
+	if (chunk->format != SRD_CHUNK_RUNS)
+		return;
+	while (logic->run + 1 < chunk->num_runs &&
+			chunk->run_starts[logic->run + 1] <= n)
+		logic->run++;
+}
 
-	/*
-	 * Convert the bit-packed sample to an array of bytes, with only 0x01
-	 * and 0x00 values, so the PD doesn't need to do any bitshifting.
-	 */
-	sample_pos = logic->inbuf + logic->itercnt * logic->di->data_unitsize;
-	for (i = 0; i < logic->di->dec_num_probes; i++) {
-		/* A probemap value of -1 means "unused optional probe". */
-		if (logic->di->dec_probemap[i] == -1) {
-			/* Value of unused probe is 0xff, instead of 0 or 1. */
-			logic->di->probe_samples[i] = 0xff;
-		} else {
-			byte_offset = logic->di->dec_probemap[i] / 8;
-			bit_offset = logic->di->dec_probemap[i] % 8;
-			sample = *(sample_pos + byte_offset) & (1 << bit_offset) ? 1 : 0;
-			logic->di->probe_samples[i] = sample;
+/*
+ * The first sample after the current one at which any probe may change
+ * value: the start of the next run for run-length encoded chunks, or
+ * simply the next sample.
+ */
+static uint64_t logic_next_change(const srd_logic *logic)
+{
+	const struct srd_chunk *chunk;
+
+	chunk = logic->chunk;
+	if (chunk->format != SRD_CHUNK_RUNS)
+		return logic->itercnt + 1;
+	if (logic->run + 1 < chunk->num_runs)
+		return chunk->run_starts[logic->run + 1];
+
+	return chunk->num_samples;
+}
+
+/*
+ * Gather bit n of each of the given planes into a single value, with bit k
+ * taken from planes[k]. This gets inlined with a constant count for the
+ * common probe counts, which turns it into straight-line code.
+ */
+static inline unsigned int gather_planes(const uint64_t *const *planes,
+		int count, uint64_t n)
+{
+	uint64_t word;
+	unsigned int shift, value;
+	int k;
+
+	word = n / 64;
+	shift = n % 64;
+	value = 0;
+	for (k = 0; k < count; k++)
+		value |= (unsigned int)((planes[k][word] >> shift) & 1) << k;
+
+	return value;
+}
+
+/* The same, for a packed sample such as the value of a run. */
+static inline unsigned int gather_sample(const uint8_t *sample,
+		const int *probes, int count)
+{
+	unsigned int value;
+	int k;
+
+	value = 0;
+	for (k = 0; k < count; k++)
+		value |= ((sample[probes[k] / 8] >> (probes[k] % 8)) & 1) << k;
+
+	return value;
+}
+
+/*
+ * Convert the current sample of the chunk to an array of bytes in
+ * di->probe_samples, with only 0x01 and 0x00 values, so the PD doesn't
+ * need to do any bitshifting. Only the mapped probes are filled in; the
+ * unused ones were set once when the extraction plan was compiled.
+ *
+ * Returns TRUE if any of the mapped probes changed value since the
+ * previous sample that was converted for this instance.
+ */
+static gboolean logic_sample_convert(srd_logic *logic)
+{
+	struct srd_decoder_inst *di;
+	const struct srd_chunk *chunk;
+	const uint8_t *run_value;
+	uint64_t word;
+	unsigned int shift;
+	uint8_t sample;
+	int k;
+	gboolean changed;
+
+	di = logic->di;
+	chunk = logic->chunk;
+	changed = !di->got_sample;
+	if (chunk->format == SRD_CHUNK_RUNS) {
+		run_value = chunk->run_values + logic->run * chunk->unitsize;
+		for (k = 0; k < di->num_mapped; k++) {
+			sample = (run_value[di->mapped_probes[k] / 8]
+					>> (di->mapped_probes[k] % 8)) & 1;
+			changed |= di->probe_samples[di->mapped_index[k]] != sample;
+			di->probe_samples[di->mapped_index[k]] = sample;
+		}
+	} else {
+		word = logic->itercnt / 64;
+		shift = logic->itercnt % 64;
+		for (k = 0; k < di->num_mapped; k++) {
+			sample = (di->mapped_planes[k][word] >> shift) & 1;
+			changed |= di->probe_samples[di->mapped_index[k]] != sample;
+			di->probe_samples[di->mapped_index[k]] = sample;
 		}
 	}
+	di->got_sample = TRUE;
+
+	return changed;
+}
+
+/*
+ * Gather the mapped probes of the current sample of the chunk into a single
+ * value, with bit k holding the value of the k-th mapped probe. This is the
+ * index of the sample's bytes object in di->py_pin_values.
+ */
+static unsigned int logic_sample_value(const srd_logic *logic)
+{
+	const struct srd_decoder_inst *di;
+	const struct srd_chunk *chunk;
+
+	di = logic->di;
+	chunk = logic->chunk;
+	if (chunk->format == SRD_CHUNK_RUNS)
+		return gather_sample(chunk->run_values +
+				logic->run * chunk->unitsize,
+				di->mapped_probes, di->num_mapped);
+
+	switch (di->num_mapped) {
+	case 1:
+		return gather_planes(di->mapped_planes, 1, logic->itercnt);
+	case 2:
+		return gather_planes(di->mapped_planes, 2, logic->itercnt);
+	case 4:
+		return gather_planes(di->mapped_planes, 4, logic->itercnt);
+	case 8:
+		return gather_planes(di->mapped_planes, 8, logic->itercnt);
+	default:
+		return gather_planes(di->mapped_planes, di->num_mapped,
+				logic->itercnt);
+	}
+}
+
+/*
+ * Update the instance's view of the sample pins to the current sample of
+ * the chunk. Returns TRUE if any of the mapped probes changed value since
+ * the previous sample that was handed to the PD.
+ */
+static gboolean logic_sample_update(srd_logic *logic)
+{
+	struct srd_decoder_inst *di;
+	unsigned int value;
+	gboolean changed;
+
+	di = logic->di;
+	if (!di->py_pin_values)
+		return logic_sample_convert(logic);
+
+	value = logic_sample_value(logic);
+	changed = !di->got_sample || value != di->pin_value;
+	di->pin_value = value;
+	di->got_sample = TRUE;
+
+	return changed;
+}
+
+/*
+ * Fill the current sample into the samplenum/sample list handed to the PD,
+ * and move on to the next one. The list itself is reused for every sample,
+ * and so are the sample bytes objects if they were prebuilt for this
+ * instance.
+ */
+static PyObject *logic_sample_get(srd_logic *logic)
+{
+	struct srd_decoder_inst *di;
+	PyObject *py_samplenum, *py_samples;
+
+	di = logic->di;
 
-	/* Prepare the next samplenum/sample list in this iteration. */
 	py_samplenum =
 	    PyLong_FromUnsignedLongLong(logic->start_samplenum +
 					logic->itercnt);
 	PyList_SetItem(logic->sample, 0, py_samplenum);
-	py_samples = PyBytes_FromStringAndSize((const char *)logic->di->probe_samples,
-					       logic->di->dec_num_probes);
+	if (di->py_pin_values) {
+		py_samples = PyTuple_GET_ITEM(di->py_pin_values, di->pin_value);
+		Py_INCREF(py_samples);
+	} else {
+		py_samples = PyBytes_FromStringAndSize(
+				(const char *)di->probe_samples,
+				di->dec_num_probes);
+	}
 	PyList_SetItem(logic->sample, 1, py_samples);
 	Py_INCREF(logic->sample);
 	logic->itercnt++;
@@ -72,6 +232,475 @@ static PyObject *srd_logic_iternext(PyObject *self)
 	return logic->sample;
 }
 
+static PyObject *srd_logic_iternext(PyObject *self)
+{
+	srd_logic *logic;
+	gboolean changed;
+
+	logic = (srd_logic *)self;
+
+	/*
+	 * In edges-only mode, runs of samples in which none of the mapped
+	 * probes change are collapsed here, so only the first sample of
+	 * each run makes it into the PD's loop. Run-length encoded chunks
+	 * are stepped through one run at a time.
+	 */
+	while (logic->itercnt < logic->chunk->num_samples) {
+		logic_seek(logic, logic->itercnt);
+		changed = logic_sample_update(logic);
+		if (changed || !logic->di->edges_only)
+			break;
+		logic_seek(logic, logic_next_change(logic));
+	}
+
+	if (logic->itercnt >= logic->chunk->num_samples) {
+		/* End iteration loop. */
+		return NULL;
+	}
+
+	return logic_sample_get(logic);
+}
+
+/** @cond PRIVATE */
+enum {
+	WAIT_LOW,
+	WAIT_HIGH,
+	WAIT_RISING,
+	WAIT_FALLING,
+	WAIT_EDGE,
+};
+
+/* A single probe's part of a wait() condition. */
+struct wait_term {
+	int probe;
+	const uint64_t *plane;
+	/* The probe's value in the sample before the chunk. */
+	uint64_t prev;
+	int type;
+};
+/** @endcond */
+
+static const struct {
+	const char *name;
+	int type;
+} wait_types[] = {
+	{"l", WAIT_LOW},
+	{"low", WAIT_LOW},
+	{"h", WAIT_HIGH},
+	{"high", WAIT_HIGH},
+	{"r", WAIT_RISING},
+	{"rising", WAIT_RISING},
+	{"f", WAIT_FALLING},
+	{"falling", WAIT_FALLING},
+	{"e", WAIT_EDGE},
+	{"edge", WAIT_EDGE},
+};
+
+/*
+ * Turn one {probe: condition} dict into terms, for the probes as
+ * numbered in the PD's own probe list. Returns the number of terms,
+ * or -1 with a Python exception set.
+ */
+static int wait_terms_parse(const srd_logic *logic, PyObject *py_cond,
+		struct wait_term *terms)
+{
+	PyObject *py_key, *py_value;
+	Py_ssize_t pos;
+	const char *name;
+	long probe;
+	unsigned int i;
+	int num_terms, mapped;
+
+	if (!PyDict_Check(py_cond)) {
+		PyErr_SetString(PyExc_TypeError,
+				"Wait condition must be a dict.");
+		return -1;
+	}
+
+	num_terms = 0;
+	pos = 0;
+	while (PyDict_Next(py_cond, &pos, &py_key, &py_value)) {
+		if (!PyLong_Check(py_key)) {
+			PyErr_SetString(PyExc_TypeError,
+					"Wait condition keys must be probe numbers.");
+			return -1;
+		}
+		probe = PyLong_AsLong(py_key);
+		if (probe < 0 || probe >= logic->di->dec_num_probes) {
+			PyErr_Format(PyExc_ValueError,
+					"Invalid probe %ld in wait condition.", probe);
+			return -1;
+		}
+		if ((mapped = logic->di->dec_probemap[probe]) == -1) {
+			PyErr_Format(PyExc_ValueError,
+					"Probe %ld in wait condition is not "
+					"connected.", probe);
+			return -1;
+		}
+		if (!PyUnicode_Check(py_value) ||
+				!(name = PyUnicode_AsUTF8(py_value))) {
+			PyErr_SetString(PyExc_TypeError,
+					"Wait condition values must be strings.");
+			return -1;
+		}
+		for (i = 0; i < G_N_ELEMENTS(wait_types); i++) {
+			if (!strcmp(name, wait_types[i].name))
+				break;
+		}
+		if (i == G_N_ELEMENTS(wait_types)) {
+			PyErr_Format(PyExc_ValueError,
+					"Invalid wait condition '%s'.", name);
+			return -1;
+		}
+		terms[num_terms].probe = mapped;
+		terms[num_terms].plane = logic->chunk->planes[mapped];
+		terms[num_terms].prev = logic->chunk->prev_bits[mapped];
+		terms[num_terms].type = wait_types[i].type;
+		num_terms++;
+	}
+
+	return num_terms;
+}
+
+/* Returns a word with bit i set if sample w * 64 + i matches the term. */
+static inline uint64_t wait_term_match(const struct wait_term *term,
+		uint64_t w)
+{
+	uint64_t cur, prev;
+
+	cur = term->plane[w];
+	prev = cur << 1 | (w == 0 ? term->prev : term->plane[w - 1] >> 63);
+
+	switch (term->type) {
+	case WAIT_LOW:
+		return ~cur;
+	case WAIT_HIGH:
+		return cur;
+	case WAIT_RISING:
+		return cur & ~prev;
+	case WAIT_FALLING:
+		return ~cur & prev;
+	default:
+		return cur ^ prev;
+	}
+}
+
+/*
+ * Find the first sample at or after the current position at which all
+ * terms of at least one of the conditions match, 64 samples at a time.
+ */
+static uint64_t wait_scan_planes(const srd_logic *logic,
+		const struct wait_term *terms, const int *cond_ends,
+		int num_conds)
+{
+	uint64_t start, words, w, match, m;
+	int c, t;
+
+	start = logic->itercnt;
+	words = (logic->chunk->num_samples + 63) / 64;
+	for (w = start / 64; w < words; w++) {
+		match = 0;
+		for (c = 0, t = 0; c < num_conds; c++) {
+			m = ~0ULL;
+			for (; t < cond_ends[c]; t++)
+				m &= wait_term_match(&terms[t], w);
+			match |= m;
+		}
+		if (w == start / 64)
+			match &= ~0ULL << (start % 64);
+		if (match)
+			return MIN(w * 64 + __builtin_ctzll(match),
+					logic->chunk->num_samples);
+	}
+
+	return logic->chunk->num_samples;
+}
+
+/*
+ * The same, for run-length encoded chunks. Edges can only occur at the
+ * start of a run, so each run needs to be looked at only once.
+ */
+static uint64_t wait_scan_runs(const srd_logic *logic,
+		const struct wait_term *terms, const int *cond_ends,
+		int num_conds)
+{
+	const struct srd_chunk *chunk;
+	uint64_t r, n;
+	unsigned int cur, prev;
+	int c, t;
+	gboolean match;
+
+	chunk = logic->chunk;
+	for (r = logic->run; r < chunk->num_runs; r++) {
+		n = MAX(logic->itercnt, chunk->run_starts[r]);
+		for (c = 0, t = 0; c < num_conds; c++) {
+			match = TRUE;
+			for (; t < cond_ends[c]; t++) {
+				cur = srd_chunk_bit(chunk, terms[t].probe, n, r);
+				if (n != chunk->run_starts[r])
+					prev = cur;
+				else if (r > 0)
+					prev = srd_chunk_bit(chunk, terms[t].probe,
+							n - 1, r - 1);
+				else
+					prev = terms[t].prev;
+				switch (terms[t].type) {
+				case WAIT_LOW:
+					match &= !cur;
+					break;
+				case WAIT_HIGH:
+					match &= cur;
+					break;
+				case WAIT_RISING:
+					match &= cur && !prev;
+					break;
+				case WAIT_FALLING:
+					match &= !cur && prev;
+					break;
+				default:
+					match &= cur != prev;
+					break;
+				}
+			}
+			if (match)
+				return n;
+		}
+	}
+
+	return chunk->num_samples;
+}
+
+static PyObject *srd_logic_wait(PyObject *self, PyObject *args)
+{
+	srd_logic *logic;
+	PyObject *py_conds, *py_cond, *py_ret;
+	struct wait_term *terms;
+	uint64_t n;
+	int *cond_ends, num_conds, num_terms, ret, i;
+
+	logic = (srd_logic *)self;
+	py_conds = Py_None;
+	if (!PyArg_ParseTuple(args, "|O", &py_conds))
+		return NULL;
+
+	/* A single condition, or a list of alternatives. */
+	if (py_conds == Py_None) {
+		num_conds = 0;
+	} else if (PyDict_Check(py_conds)) {
+		num_conds = 1;
+	} else if (PyList_Check(py_conds) || PyTuple_Check(py_conds)) {
+		num_conds = PySequence_Fast_GET_SIZE(py_conds);
+	} else {
+		PyErr_SetString(PyExc_TypeError,
+				"Wait conditions must be a dict or a list.");
+		return NULL;
+	}
+
+	num_terms = 0;
+	for (i = 0; i < num_conds; i++) {
+		py_cond = PyDict_Check(py_conds) ? py_conds :
+			PySequence_Fast_GET_ITEM(py_conds, i);
+		if (PyDict_Check(py_cond))
+			num_terms += PyDict_Size(py_cond);
+	}
+	terms = g_try_malloc(sizeof(struct wait_term) * MAX(num_terms, 1));
+	cond_ends = g_try_malloc(sizeof(int) * MAX(num_conds, 1));
+	if (!terms || !cond_ends) {
+		g_free(terms);
+		g_free(cond_ends);
+		return PyErr_NoMemory();
+	}
+
+	num_terms = 0;
+	for (i = 0; i < num_conds; i++) {
+		py_cond = PyDict_Check(py_conds) ? py_conds :
+			PySequence_Fast_GET_ITEM(py_conds, i);
+		if ((ret = wait_terms_parse(logic, py_cond,
+				terms + num_terms)) < 0)
+			break;
+		num_terms += ret;
+		cond_ends[i] = num_terms;
+	}
+
+	py_ret = NULL;
+	if (i == num_conds) {
+		if (num_conds == 0) {
+			/* An empty condition, which matches anything. */
+			cond_ends[0] = 0;
+			num_conds = 1;
+		}
+		logic_seek(logic, logic->itercnt);
+		if (logic->chunk->format == SRD_CHUNK_RUNS)
+			n = wait_scan_runs(logic, terms, cond_ends, num_conds);
+		else
+			n = wait_scan_planes(logic, terms, cond_ends, num_conds);
+		logic_seek(logic, n);
+		if (logic->itercnt < logic->chunk->num_samples) {
+			logic_sample_update(logic);
+			py_ret = logic_sample_get(logic);
+		} else {
+			/* Nothing found in this chunk. */
+			Py_INCREF(Py_None);
+			py_ret = Py_None;
+		}
+	}
+	g_free(terms);
+	g_free(cond_ends);
+
+	return py_ret;
+}
+
+/*
+ * Export the raw, bit-packed chunk as a read-only buffer of bytes, without
+ * copying it. The chunk belongs to the frontend, and is only valid for as
+ * long as the decode() call it was passed to. All views are taken from one
+ * memoryview over it, which is released once decode() returns. A PD which
+ * keeps a view past that fails decode(), and its instance decodes nothing
+ * more, as the view still points into the frontend's buffer.
+ */
+static int srd_logic_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+	srd_logic *logic;
+
+	logic = (srd_logic *)self;
+	if (!logic->inbuf) {
+		PyErr_SetString(PyExc_BufferError,
+				"No raw sample data available.");
+		view->obj = NULL;
+		return -1;
+	}
+
+	if (!logic->py_view && !(logic->py_view = PyMemoryView_FromMemory(
+			(char *)logic->inbuf, logic->inbuflen, PyBUF_READ))) {
+		view->obj = NULL;
+		return -1;
+	}
+
+	return PyObject_GetBuffer(logic->py_view, view, flags);
+}
+
+static PyObject *srd_logic_skip(PyObject *self, PyObject *args)
+{
+	srd_logic *logic;
+	unsigned long long samplenum;
+
+	logic = (srd_logic *)self;
+	if (!PyArg_ParseTuple(args, "K", &samplenum))
+		return NULL;
+
+	/* A sample which was already passed means the next one. */
+	if (samplenum > logic->start_samplenum + logic->itercnt)
+		logic_seek(logic, MIN(samplenum - logic->start_samplenum,
+				logic->chunk->num_samples));
+	else
+		logic_seek(logic, logic->itercnt);
+
+	if (logic->itercnt >= logic->chunk->num_samples) {
+		/* The sample is in a later chunk. */
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	logic_sample_update(logic);
+
+	return logic_sample_get(logic);
+}
+
+static PyObject *srd_logic_edges(PyObject *self, PyObject *args)
+{
+	srd_logic *logic;
+	PyObject *py_edges, *py_view, *py_res;
+	long probe;
+	int mapped;
+
+	logic = (srd_logic *)self;
+	if (!PyArg_ParseTuple(args, "l", &probe))
+		return NULL;
+
+	if (probe < 0 || probe >= logic->di->dec_num_probes) {
+		PyErr_Format(PyExc_ValueError, "Invalid probe %ld.", probe);
+		return NULL;
+	}
+	if ((mapped = logic->di->dec_probemap[probe]) == -1) {
+		PyErr_Format(PyExc_ValueError, "Probe %ld is not connected.",
+				probe);
+		return NULL;
+	}
+
+	if (!(py_edges = srd_chunk_edges(logic->chunk, mapped)))
+		return NULL;
+	if (!(py_view = PyMemoryView_FromObject(py_edges)))
+		return NULL;
+	py_res = PyObject_CallMethod(py_view, "cast", "s", "Q");
+	Py_DecRef(py_view);
+
+	return py_res;
+}
+
+static PyObject *srd_logic_get_unitsize(PyObject *self, void *closure)
+{
+	(void)closure;
+
+	return PyLong_FromLong(((srd_logic *)self)->chunk->unitsize);
+}
+
+static PyObject *srd_logic_get_start_samplenum(PyObject *self, void *closure)
+{
+	(void)closure;
+
+	return PyLong_FromUnsignedLongLong(((srd_logic *)self)->start_samplenum);
+}
+
+static void srd_logic_dealloc(PyObject *self)
+{
+	Py_XDECREF(((srd_logic *)self)->sample);
+	Py_XDECREF(((srd_logic *)self)->py_view);
+	PyObject_Del(self);
+}
+
+static PyMethodDef srd_logic_methods[] = {
+	{"wait", srd_logic_wait, METH_VARARGS,
+	 "Skip ahead to the next sample matching the given conditions.\n\n"
+	 "Takes a dict of {probe: condition}, where condition is one of 'l', "
+	 "'h', 'r', 'f' or 'e' (low, high, rising, falling, either edge), or "
+	 "a list of such dicts, any of which can match. All probes in a "
+	 "dict must match at the same sample. Without conditions, the next "
+	 "sample matches.\n\n"
+	 "Returns the [samplenum, pins] of the matching sample, like the "
+	 "iterator does, or None when the chunk holds no match. In that "
+	 "case, decode() should return and wait again in the next chunk."},
+	{"skip", srd_logic_skip, METH_VARARGS,
+	 "Skip ahead to the given absolute sample number. For a decimated "
+	 "instance, that's a number of the decimated samples, like those "
+	 "the iterator returns.\n\n"
+	 "Returns the [samplenum, pins] of that sample, like the iterator "
+	 "does, and continues iterating after it. If the sample was already "
+	 "passed, the next sample is returned instead. If it lies beyond "
+	 "this chunk, None is returned, and decode() should return and skip "
+	 "again in the next chunk."},
+	{"edges", srd_logic_edges, METH_VARARGS,
+	 "List the changes of the given probe in this chunk.\n\n"
+	 "Returns a read-only memoryview of unsigned 64-bit integers, "
+	 "holding the absolute sample numbers at which the probe's value "
+	 "differs from the sample before, in ascending order. For a "
+	 "decimated instance, they are numbers of the decimated samples. "
+	 "The list is built once per chunk and shared by all decoders "
+	 "using the probe, unless they are decimated."},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyBufferProcs srd_logic_as_buffer = {
+	.bf_getbuffer = srd_logic_getbuffer,
+};
+
+static PyGetSetDef srd_logic_getset[] = {
+	{"unitsize", srd_logic_get_unitsize, NULL,
+	 "Size of one sample in the raw buffer, in bytes", NULL},
+	{"start_samplenum", srd_logic_get_start_samplenum, NULL,
+	 "Sample number of the first sample in the raw buffer", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
 /** @cond PRIVATE */
 SRD_PRIV PyTypeObject srd_logic_type = {
 	PyVarObject_HEAD_INIT(NULL, 0)
@@ -79,7 +708,11 @@ SRD_PRIV PyTypeObject srd_logic_type = {
 	.tp_basicsize = sizeof(srd_logic),
 	.tp_flags = Py_TPFLAGS_DEFAULT,
 	.tp_doc = "Sigrokdecode logic sample object",
+	.tp_dealloc = srd_logic_dealloc,
 	.tp_iter = srd_logic_iter,
 	.tp_iternext = srd_logic_iternext,
+	.tp_as_buffer = &srd_logic_as_buffer,
+	.tp_getset = srd_logic_getset,
+	.tp_methods = srd_logic_methods,
 };
 /** @endcond */
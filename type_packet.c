@@ -0,0 +1,415 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "libsigrokdecode.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include "libsigrokdecode-internal.h"
+#include "config.h"
+#include <string.h>
+
+/*
+ * Packets the I2C, SPI and UART decoders pass to the decoders stacked on
+ * top of them. They unpack and index like the lists they replace, with
+ * the command's name first, but also carry the command as an integer
+ * code, and have the values as attributes.
+ */
+
+/* The commands, in the order of their codes. */
+static const char *const packet_cmd_names[] = {
+	/* I2C */
+	"START",
+	"START REPEAT",
+	"STOP",
+	"ACK",
+	"NACK",
+	"ADDRESS READ",
+	"ADDRESS WRITE",
+	"DATA READ",
+	"DATA WRITE",
+	/* SPI, and UART */
+	"DATA",
+	"CS-CHANGE",
+	/* UART */
+	"STARTBIT",
+	"INVALID STARTBIT",
+	"PARITYBIT",
+	"PARITY ERROR",
+	"STOPBIT",
+	"INVALID STOPBIT",
+};
+
+#define NUM_CMDS G_N_ELEMENTS(packet_cmd_names)
+
+/* Interned names, so unpacked commands compare by identity. */
+static PyObject *packet_cmds[NUM_CMDS];
+
+/* The codes each packet type takes, as a bitmask. */
+#define CMD_MASK(first, last) \
+	(((1U << ((last) + 1)) - 1) & ~((1U << (first)) - 1))
+#define I2C_CMDS CMD_MASK(0, 8)
+#define SPI_CMDS CMD_MASK(9, 10)
+#define UART_CMDS (CMD_MASK(9, 9) | CMD_MASK(11, 16))
+
+/*
+ * Deallocated packets are kept for reuse in here, as PDs create one per
+ * packet and the next one of the same size is never far off. The list is
+ * shared by all three packet types, which is only safe as long as they
+ * all have the same object size: an I2C packet uses one value, but
+ * srd_packet always reserves room for two.
+ */
+#define FREE_LIST_MAX 64
+static srd_packet *free_list[FREE_LIST_MAX];
+static int free_list_len = 0;
+
+/** @cond PRIVATE */
+extern SRD_PRIV PyTypeObject srd_i2c_packet_type;
+extern SRD_PRIV PyTypeObject srd_spi_packet_type;
+extern SRD_PRIV PyTypeObject srd_uart_packet_type;
+/** @endcond */
+
+static int packet_num_values(const PyTypeObject *type)
+{
+	return type == &srd_i2c_packet_type ? 1 : 2;
+}
+
+static unsigned int packet_cmd_mask(const PyTypeObject *type)
+{
+	if (type == &srd_i2c_packet_type)
+		return I2C_CMDS;
+	if (type == &srd_spi_packet_type)
+		return SPI_CMDS;
+
+	return UART_CMDS;
+}
+
+/* Find the code of a command given by name, or as a code already. */
+static int packet_cmd_code(PyObject *py_cmd)
+{
+	unsigned int i;
+	long code;
+
+	if (PyUnicode_Check(py_cmd)) {
+		/* Literals in the PDs are often interned too. */
+		for (i = 0; i < NUM_CMDS; i++) {
+			if (py_cmd == packet_cmds[i])
+				return i;
+		}
+		for (i = 0; i < NUM_CMDS; i++) {
+			if (PyUnicode_Compare(py_cmd, packet_cmds[i]) == 0)
+				return i;
+		}
+		PyErr_Format(PyExc_ValueError, "Unknown packet command %R.",
+				py_cmd);
+		return -1;
+	}
+
+	code = PyLong_AsLong(py_cmd);
+	if (code == -1 && PyErr_Occurred())
+		return -1;
+	if (code < 0 || code >= (long)NUM_CMDS) {
+		PyErr_Format(PyExc_ValueError, "Unknown packet command %ld.",
+				code);
+		return -1;
+	}
+
+	return code;
+}
+
+static PyObject *packet_build(PyTypeObject *type, PyObject *const *args,
+		Py_ssize_t nargs)
+{
+	srd_packet *packet;
+	int code, num_values, i;
+
+	num_values = packet_num_values(type);
+	if (nargs != 1 + num_values) {
+		PyErr_Format(PyExc_TypeError, "%s() takes exactly %d "
+				"arguments (%zd given)", type->tp_name,
+				1 + num_values, nargs);
+		return NULL;
+	}
+	if ((code = packet_cmd_code(args[0])) < 0)
+		return NULL;
+	if (!(packet_cmd_mask(type) & (1U << code))) {
+		PyErr_Format(PyExc_ValueError, "%s() doesn't take packet "
+				"command %s.", type->tp_name,
+				packet_cmd_names[code]);
+		return NULL;
+	}
+
+	if (free_list_len > 0) {
+		packet = free_list[--free_list_len];
+		PyObject_Init((PyObject *)packet, type);
+	} else if (!(packet = PyObject_New(srd_packet, type))) {
+		return NULL;
+	}
+	packet->code = code;
+	packet->num_values = num_values;
+	for (i = 0; i < num_values; i++) {
+		Py_INCREF(args[1 + i]);
+		packet->values[i] = args[1 + i];
+	}
+
+	return (PyObject *)packet;
+}
+
+static PyObject *packet_new(PyTypeObject *type, PyObject *args,
+		PyObject *kwargs)
+{
+	if (kwargs && PyDict_Size(kwargs) > 0) {
+		PyErr_Format(PyExc_TypeError, "%s() takes no keyword "
+				"arguments", type->tp_name);
+		return NULL;
+	}
+
+	return packet_build(type, &PyTuple_GET_ITEM(args, 0),
+			PyTuple_GET_SIZE(args));
+}
+
+#if PY_VERSION_HEX >= 0x03090000
+/* Creating a packet from Python skips the argument tuple of packet_new(). */
+static PyObject *packet_vectorcall(PyObject *type, PyObject *const *args,
+		size_t nargsf, PyObject *kwnames)
+{
+	if (kwnames && PyTuple_GET_SIZE(kwnames) > 0) {
+		PyErr_Format(PyExc_TypeError, "%s() takes no keyword "
+				"arguments", ((PyTypeObject *)type)->tp_name);
+		return NULL;
+	}
+
+	return packet_build((PyTypeObject *)type, args,
+			PyVectorcall_NARGS(nargsf));
+}
+#endif
+
+static void packet_dealloc(PyObject *self)
+{
+	srd_packet *packet;
+	int i;
+
+	packet = (srd_packet *)self;
+	for (i = 0; i < packet->num_values; i++)
+		Py_CLEAR(packet->values[i]);
+
+	/* Nothing may be kept once the interpreter is going away. */
+	if (free_list_len < FREE_LIST_MAX && Py_IsInitialized())
+		free_list[free_list_len++] = packet;
+	else
+		PyObject_Del(self);
+}
+
+static Py_ssize_t packet_length(PyObject *self)
+{
+	return 1 + ((srd_packet *)self)->num_values;
+}
+
+static PyObject *packet_item(PyObject *self, Py_ssize_t i)
+{
+	srd_packet *packet;
+	PyObject *py_item;
+
+	packet = (srd_packet *)self;
+	if (i < 0 || i > packet->num_values) {
+		PyErr_SetString(PyExc_IndexError, "packet index out of range");
+		return NULL;
+	}
+	py_item = i == 0 ? packet_cmds[packet->code] : packet->values[i - 1];
+	Py_INCREF(py_item);
+
+	return py_item;
+}
+
+static PyObject *packet_repr(PyObject *self)
+{
+	srd_packet *packet;
+	const char *name;
+
+	packet = (srd_packet *)self;
+	name = strrchr(Py_TYPE(self)->tp_name, '.') + 1;
+	if (packet->num_values == 1)
+		return PyUnicode_FromFormat("%s(%R, %R)", name,
+				packet_cmds[packet->code], packet->values[0]);
+
+	return PyUnicode_FromFormat("%s(%R, %R, %R)", name,
+			packet_cmds[packet->code], packet->values[0],
+			packet->values[1]);
+}
+
+static PyObject *packet_get_cmd(PyObject *self, void *closure)
+{
+	PyObject *py_cmd;
+
+	(void)closure;
+
+	py_cmd = packet_cmds[((srd_packet *)self)->code];
+	Py_INCREF(py_cmd);
+
+	return py_cmd;
+}
+
+static PyObject *packet_get_code(PyObject *self, void *closure)
+{
+	(void)closure;
+
+	return PyLong_FromLong(((srd_packet *)self)->code);
+}
+
+/* The closure is the index of the value. */
+static PyObject *packet_get_value(PyObject *self, void *closure)
+{
+	PyObject *py_value;
+
+	py_value = ((srd_packet *)self)->values[GPOINTER_TO_INT(closure)];
+	Py_INCREF(py_value);
+
+	return py_value;
+}
+
+static PySequenceMethods packet_as_sequence = {
+	.sq_length = packet_length,
+	.sq_item = packet_item,
+};
+
+#define PACKET_GETSET_COMMON \
+	{"cmd", packet_get_cmd, NULL, "Name of the command", NULL}, \
+	{"code", packet_get_code, NULL, \
+	 "The command as one of the CMD_* constants", NULL}
+
+static PyGetSetDef i2c_packet_getset[] = {
+	PACKET_GETSET_COMMON,
+	{"databyte", packet_get_value, NULL,
+	 "The address or data byte, or None", GINT_TO_POINTER(0)},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyGetSetDef spi_packet_getset[] = {
+	PACKET_GETSET_COMMON,
+	{"mosi", packet_get_value, NULL,
+	 "MOSI data, or the old CS# value for CS-CHANGE",
+	 GINT_TO_POINTER(0)},
+	{"miso", packet_get_value, NULL,
+	 "MISO data, or the new CS# value for CS-CHANGE",
+	 GINT_TO_POINTER(1)},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyGetSetDef uart_packet_getset[] = {
+	PACKET_GETSET_COMMON,
+	{"rxtx", packet_get_value, NULL, "RX or TX", GINT_TO_POINTER(0)},
+	{"data", packet_get_value, NULL, "The bit or byte received",
+	 GINT_TO_POINTER(1)},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+#if PY_VERSION_HEX >= 0x03090000
+#define PACKET_TYPE_VECTORCALL .tp_vectorcall = packet_vectorcall,
+#else
+#define PACKET_TYPE_VECTORCALL
+#endif
+
+#define PACKET_TYPE(_name, _doc, _getset) { \
+	PyVarObject_HEAD_INIT(NULL, 0) \
+	.tp_name = "sigrokdecode." _name, \
+	.tp_basicsize = sizeof(srd_packet), \
+	.tp_flags = Py_TPFLAGS_DEFAULT, \
+	.tp_doc = _doc, \
+	.tp_new = packet_new, \
+	.tp_dealloc = packet_dealloc, \
+	.tp_repr = packet_repr, \
+	.tp_as_sequence = &packet_as_sequence, \
+	.tp_getset = _getset, \
+	PACKET_TYPE_VECTORCALL \
+}
+
+/** @cond PRIVATE */
+SRD_PRIV PyTypeObject srd_i2c_packet_type = PACKET_TYPE("I2CPacket",
+	"I2CPacket(cmd, databyte): packet of the I2C decoder",
+	i2c_packet_getset);
+
+SRD_PRIV PyTypeObject srd_spi_packet_type = PACKET_TYPE("SPIPacket",
+	"SPIPacket(cmd, mosi, miso): packet of the SPI decoder",
+	spi_packet_getset);
+
+SRD_PRIV PyTypeObject srd_uart_packet_type = PACKET_TYPE("UARTPacket",
+	"UARTPacket(cmd, rxtx, data): packet of the UART decoder",
+	uart_packet_getset);
+/** @endcond */
+
+/**
+ * Add the packet types, and a CMD_* constant for each command, to the
+ * sigrokdecode module.
+ *
+ * @param mod The module.
+ *
+ * @return 0 upon success, -1 with a Python exception set otherwise.
+ *
+ * @private
+ */
+SRD_PRIV int srd_packet_module_add(PyObject *mod)
+{
+	PyTypeObject *types[] = {
+		&srd_i2c_packet_type,
+		&srd_spi_packet_type,
+		&srd_uart_packet_type,
+	};
+	char *name, *c;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < G_N_ELEMENTS(types); i++) {
+		if (PyType_Ready(types[i]) < 0)
+			return -1;
+		Py_INCREF(types[i]);
+		if (PyModule_AddObject(mod, strrchr(types[i]->tp_name, '.') + 1,
+		    (PyObject *)types[i]) == -1)
+			return -1;
+	}
+
+	for (i = 0; i < NUM_CMDS; i++) {
+		if (!(packet_cmds[i] = PyUnicode_InternFromString(
+		    packet_cmd_names[i])))
+			return -1;
+		/* "CS-CHANGE" becomes CMD_CS_CHANGE. */
+		name = g_strconcat("CMD_", packet_cmd_names[i], NULL);
+		for (c = name; *c; c++) {
+			if (*c == ' ' || *c == '-')
+				*c = '_';
+		}
+		ret = PyModule_AddIntConstant(mod, name, i);
+		g_free(name);
+		if (ret == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Free the packets kept for reuse, and the command names, before the
+ * interpreter is finalized.
+ *
+ * @private
+ */
+SRD_PRIV void srd_packet_cleanup(void)
+{
+	unsigned int i;
+
+	while (free_list_len > 0)
+		PyObject_Del(free_list[--free_list_len]);
+	for (i = 0; i < NUM_CMDS; i++)
+		Py_CLEAR(packet_cmds[i]);
+}
@@ -0,0 +1,633 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libsigrokdecode.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include "libsigrokdecode-internal.h"
+#include "config.h"
+#include <string.h>
+
+/**
+ * @file
+ *
+ * Unpacking of logic sample data into per-probe bit planes.
+ *
+ * A chunk of samples as received by srd_session_send() is bit-packed per
+ * sample: byte k of each sample holds probes k*8 to k*8+7. The decoders
+ * however look at individual probes, so the chunk is transposed once per
+ * session into one bit plane per probe, where bit n of the plane holds the
+ * value of that probe in sample n of the chunk.
+ *
+ * The transpose works on blocks of 64 samples of one byte lane at a time,
+ * and turns them into one 64-bit plane word for each of the 8 probes in
+ * that lane. SSE2 and AVX2 versions of that kernel are picked at runtime
+ * when the CPU supports them. Samples of 2, 4 or 8 bytes are first split
+ * into their byte lanes by loops specialized for those sizes.
+ *
+ * Once unpacked, the planes can be passed through a glitch filter, which
+ * also works on whole words at a time wherever the signal is stable.
+ * Decoders of slow protocols can be handed a decimated copy of the planes
+ * they use instead, with one sample for every group of samples, and
+ * decoders which work on whole chunks get each plane expanded to bytes.
+ * The sample numbers of the changes on a plane can be listed as well.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SRD_UNPACK_X86
+#include <immintrin.h>
+#endif
+
+/** @cond PRIVATE */
+typedef void (*transpose_func)(const uint8_t *bytes, uint64_t *words);
+/** @endcond */
+
+static transpose_func transpose = NULL;
+
+static inline uint64_t load_le64(const uint8_t *p)
+{
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 |
+		(uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+		(uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
+		(uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+/*
+ * Transpose 64 bytes into 8 plane words: bit i of words[b] is bit b of
+ * bytes[i].
+ *
+ * The multiplication gathers bit b of all 8 bytes in x into the top byte,
+ * in byte order, without any carries between the partial products.
+ */
+static void transpose_scalar(const uint8_t *bytes, uint64_t *words)
+{
+	uint64_t x, w;
+	int i, b;
+
+	for (b = 0; b < 8; b++)
+		words[b] = 0;
+
+	for (i = 0; i < 8; i++) {
+		x = load_le64(bytes + i * 8);
+		for (b = 0; b < 8; b++) {
+			w = ((x >> b) & 0x0101010101010101ULL) *
+					0x0102040810204080ULL >> 56;
+			words[b] |= w << (i * 8);
+		}
+	}
+}
+
+#ifdef SRD_UNPACK_X86
+/*
+ * The movemask instructions collect the top bit of every byte. Adding a
+ * vector to itself shifts each byte left by one, so the next lower bit
+ * moves into the top position for the next round.
+ */
+__attribute__((target("sse2")))
+static void transpose_sse2(const uint8_t *bytes, uint64_t *words)
+{
+	__m128i v0, v1, v2, v3;
+	int b;
+
+	v0 = _mm_loadu_si128((const __m128i *)bytes);
+	v1 = _mm_loadu_si128((const __m128i *)(bytes + 16));
+	v2 = _mm_loadu_si128((const __m128i *)(bytes + 32));
+	v3 = _mm_loadu_si128((const __m128i *)(bytes + 48));
+	for (b = 7; b >= 0; b--) {
+		words[b] = (uint64_t)(uint16_t)_mm_movemask_epi8(v0) |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(v1) << 16 |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(v2) << 32 |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(v3) << 48;
+		v0 = _mm_add_epi8(v0, v0);
+		v1 = _mm_add_epi8(v1, v1);
+		v2 = _mm_add_epi8(v2, v2);
+		v3 = _mm_add_epi8(v3, v3);
+	}
+}
+
+__attribute__((target("avx2")))
+static void transpose_avx2(const uint8_t *bytes, uint64_t *words)
+{
+	__m256i v0, v1;
+	int b;
+
+	v0 = _mm256_loadu_si256((const __m256i *)bytes);
+	v1 = _mm256_loadu_si256((const __m256i *)(bytes + 32));
+	for (b = 7; b >= 0; b--) {
+		words[b] = (uint64_t)(uint32_t)_mm256_movemask_epi8(v0) |
+			(uint64_t)(uint32_t)_mm256_movemask_epi8(v1) << 32;
+		v0 = _mm256_add_epi8(v0, v0);
+		v1 = _mm256_add_epi8(v1, v1);
+	}
+}
+#endif
+
+static transpose_func transpose_select(void)
+{
+#ifdef SRD_UNPACK_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		srd_dbg("Using AVX2 sample unpacking.");
+		return transpose_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		srd_dbg("Using SSE2 sample unpacking.");
+		return transpose_sse2;
+	}
+#endif
+	srd_dbg("Using scalar sample unpacking.");
+
+	return transpose_scalar;
+}
+
+/*
+ * Split n samples of unitsize bytes each into one array of bytes per byte
+ * lane. This gets inlined with a constant unitsize for the common sample
+ * sizes, so the compiler can unroll and vectorize it for each of them.
+ */
+static inline void deinterleave(uint8_t (*lanes)[64], const uint8_t *src,
+		uint64_t n, int unitsize)
+{
+	uint64_t i;
+	int k;
+
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < unitsize; k++)
+			lanes[k][i] = src[i * unitsize + k];
+	}
+}
+
+static void transpose_lane(uint64_t **planes, const uint8_t *src, int lane,
+		uint8_t lane_mask, uint64_t block)
+{
+	uint64_t words[8];
+	int b;
+
+	transpose(src, words);
+	for (b = 0; b < 8; b++) {
+		if (lane_mask & (1 << b))
+			planes[lane * 8 + b][block] = words[b];
+	}
+}
+
+/**
+ * Unpack a chunk of bit-packed samples into per-probe bit planes.
+ *
+ * @param planes Array of unitsize * 8 plane pointers. Each plane used in
+ *               lane_masks must have room for (num_samples + 63) / 64 words.
+ * @param inbuf The bit-packed samples.
+ * @param num_samples Number of samples in inbuf.
+ * @param unitsize Size of one sample in inbuf, in bytes.
+ * @param lane_masks Array of unitsize masks, with the bits set for the
+ *                   probes in that byte lane which need to be unpacked.
+ *
+ * @private
+ */
+SRD_PRIV void srd_unpack_planes(uint64_t **planes, const uint8_t *inbuf,
+		uint64_t num_samples, int unitsize, const uint8_t *lane_masks)
+{
+	const uint8_t *src;
+	uint8_t lanes[8][64];
+	uint64_t block, n, i;
+	int k;
+
+	if (!transpose)
+		transpose = transpose_select();
+
+	for (block = 0; block * 64 < num_samples; block++) {
+		n = MIN(num_samples - block * 64, 64);
+		src = inbuf + block * 64 * unitsize;
+
+		if (unitsize == 1 && n == 64) {
+			/* Already laid out the way the kernel wants it. */
+			if (lane_masks[0])
+				transpose_lane(planes, src, 0, lane_masks[0],
+						block);
+			continue;
+		}
+
+		if (unitsize > 8) {
+			/* Wide samples, gather only the lanes in use. */
+			for (k = 0; k < unitsize; k++) {
+				if (!lane_masks[k])
+					continue;
+				for (i = 0; i < n; i++)
+					lanes[0][i] = src[i * unitsize + k];
+				memset(lanes[0] + n, 0, 64 - n);
+				transpose_lane(planes, lanes[0], k,
+						lane_masks[k], block);
+			}
+			continue;
+		}
+
+		switch (unitsize) {
+		case 1:
+			deinterleave(lanes, src, n, 1);
+			break;
+		case 2:
+			deinterleave(lanes, src, n, 2);
+			break;
+		case 4:
+			deinterleave(lanes, src, n, 4);
+			break;
+		case 8:
+			deinterleave(lanes, src, n, 8);
+			break;
+		default:
+			deinterleave(lanes, src, n, unitsize);
+			break;
+		}
+		for (k = 0; k < unitsize; k++) {
+			if (!lane_masks[k])
+				continue;
+			memset(lanes[k] + n, 0, 64 - n);
+			transpose_lane(planes, lanes[k], k, lane_masks[k],
+					block);
+		}
+	}
+}
+
+/*
+ * Find the first sample at or after start at which the plane doesn't have
+ * the given value, or num_samples if there is none.
+ */
+static uint64_t plane_find_change(const uint64_t *plane, uint64_t start,
+		uint64_t num_samples, unsigned int value)
+{
+	uint64_t words, w, x;
+
+	words = (num_samples + 63) / 64;
+	for (w = start / 64; w < words; w++) {
+		x = plane[w] ^ (value ? ~0ULL : 0);
+		if (w == start / 64)
+			x &= ~0ULL << (start % 64);
+		if (x)
+			return MIN(w * 64 + __builtin_ctzll(x), num_samples);
+	}
+
+	return num_samples;
+}
+
+/* Set samples start up to end of the plane to the given value. */
+static void plane_fill(uint64_t *plane, uint64_t start, uint64_t end,
+		unsigned int value)
+{
+	uint64_t w, mask;
+
+	for (w = start / 64; w * 64 < end; w++) {
+		mask = ~0ULL;
+		if (w == start / 64)
+			mask &= ~0ULL << (start % 64);
+		if (end - w * 64 < 64)
+			mask &= ~(~0ULL << (end - w * 64));
+		if (value)
+			plane[w] |= mask;
+		else
+			plane[w] &= ~mask;
+	}
+}
+
+/**
+ * Remove all pulses shorter than width samples from a bit plane.
+ *
+ * A change of level only makes it through once the new level has lasted
+ * for width samples. It then shows up at the same sample as in the input,
+ * so the timing of clean signals is not affected. Whether a change within
+ * the last width - 1 samples of the plane is real can't be told; it is
+ * removed. Callers which get more samples later hold those back, and
+ * filter them again in front of the next chunk.
+ *
+ * @param plane The plane to filter in place.
+ * @param num_samples Number of samples in the plane.
+ * @param width Minimum width of a pulse to let through, in samples.
+ * @param level The level of the filter's output before this plane, or
+ *              0xff if there was none.
+ *
+ * @private
+ */
+SRD_PRIV void srd_glitch_filter(uint64_t *plane, uint64_t num_samples,
+		uint64_t width, unsigned int level)
+{
+	uint64_t start, end;
+	unsigned int value;
+
+	value = plane[0] & 1;
+	if (level > 1)
+		level = value;
+
+	for (start = 0; start < num_samples; start = end, value = !value) {
+		end = plane_find_change(plane, start, num_samples, value);
+		if (value == level)
+			continue;
+		if (end - start >= width)
+			level = value;
+		else
+			plane_fill(plane, start, end, level);
+	}
+}
+
+/**
+ * Copy samples start up to start + len of a bit plane into another one,
+ * starting at its first sample.
+ *
+ * @param out The plane to copy into, with room for len samples.
+ * @param plane The plane to copy from.
+ * @param start The first sample to copy.
+ * @param len The number of samples to copy.
+ *
+ * @private
+ */
+SRD_PRIV void srd_plane_copy(uint64_t *out, const uint64_t *plane,
+		uint64_t start, uint64_t len)
+{
+	uint64_t w, x;
+	unsigned int shift;
+
+	shift = start % 64;
+	plane += start / 64;
+	for (w = 0; w * 64 < len; w++) {
+		x = plane[w] >> shift;
+		if (shift && w * 64 + 64 - shift < len)
+			x |= plane[w + 1] << (64 - shift);
+		out[w] = x;
+	}
+	if (len % 64)
+		out[len / 64] &= ~(~0ULL << (len % 64));
+}
+
+/**
+ * Move the samples of a bit plane back by head_len samples, and put the
+ * first head_len samples of another plane in front of them.
+ *
+ * @param plane The plane to prepend to, with room for num_samples +
+ *              head_len samples.
+ * @param num_samples Number of samples in the plane.
+ * @param head The plane holding the samples to prepend.
+ * @param head_len Number of samples to prepend.
+ *
+ * @private
+ */
+SRD_PRIV void srd_plane_prepend(uint64_t *plane, uint64_t num_samples,
+		const uint64_t *head, uint64_t head_len)
+{
+	uint64_t words, src_words, skip, w, hi, lo, total;
+	unsigned int shift;
+
+	total = num_samples + head_len;
+	words = (total + 63) / 64;
+	src_words = (num_samples + 63) / 64;
+	skip = head_len / 64;
+	shift = head_len % 64;
+
+	/* From the top down, so nothing is overwritten before it's moved. */
+	for (w = words; w-- > skip;) {
+		hi = w - skip < src_words ? plane[w - skip] : 0;
+		lo = w > skip && w - skip - 1 < src_words ?
+			plane[w - skip - 1] : 0;
+		plane[w] = shift ? hi << shift | lo >> (64 - shift) : hi;
+	}
+	for (w = 0; w < skip; w++)
+		plane[w] = head[w];
+	if (shift)
+		plane[skip] = (plane[skip] & (~0ULL << shift)) |
+			(head[skip] & ~(~0ULL << shift));
+	if (total % 64)
+		plane[words - 1] &= ~(~0ULL << (total % 64));
+}
+
+/*
+ * Count the samples start up to end of a probe which are high, moving the
+ * run cursor along for run-length encoded chunks.
+ */
+static uint64_t chunk_count_high(const struct srd_chunk *chunk, int probe,
+		uint64_t start, uint64_t end, uint64_t *run)
+{
+	const uint64_t *plane;
+	uint64_t w, x, count, run_end;
+
+	count = 0;
+	if (chunk->format == SRD_CHUNK_RUNS) {
+		while (start < end) {
+			run_end = *run + 1 < chunk->num_runs ?
+				chunk->run_starts[*run + 1] : chunk->num_samples;
+			if (srd_chunk_bit(chunk, probe, start, *run))
+				count += MIN(run_end, end) - start;
+			start = MIN(run_end, end);
+			if (start == run_end && *run + 1 < chunk->num_runs)
+				(*run)++;
+		}
+		return count;
+	}
+
+	plane = chunk->planes[probe];
+	for (w = start / 64; w * 64 < end; w++) {
+		x = plane[w];
+		if (w == start / 64)
+			x &= ~0ULL << (start % 64);
+		if (end - w * 64 < 64)
+			x &= ~(~0ULL << (end - w * 64));
+		count += __builtin_popcountll(x);
+	}
+
+	return count;
+}
+
+/**
+ * Decimate one probe of a chunk into a bit plane.
+ *
+ * Samples are taken in groups of factor samples, aligned to multiples of
+ * factor in the capture, and each complete group becomes one bit of the
+ * output plane. With SRD_DECIMATE_MAJORITY, that bit is the value of most
+ * of the group's samples, or the previous output on a tie. With
+ * SRD_DECIMATE_EDGES, the output changes whenever any sample in the group
+ * differs from the previous output, so even a pulse of a single sample
+ * lasts for one output sample.
+ *
+ * The chunk must follow on from the previous one. A group which is still
+ * incomplete at its end is carried over to the next chunk.
+ *
+ * @param out The plane to write, with room for all complete groups.
+ * @param chunk The chunk to decimate.
+ * @param probe The probe to decimate.
+ * @param factor The number of samples in a group.
+ * @param mode SRD_DECIMATE_MAJORITY or SRD_DECIMATE_EDGES.
+ * @param group_len Number of samples of the current group already seen in
+ *                  previous chunks.
+ * @param high Number of those samples which were high. Updated for the
+ *             next chunk.
+ * @param level The previous output, or 0xff if there is none yet. Updated
+ *              for the next chunk.
+ *
+ * @return The number of samples of the incomplete group at the end.
+ *
+ * @private
+ */
+SRD_PRIV uint64_t srd_decimate(uint64_t *out, const struct srd_chunk *chunk,
+		int probe, uint64_t factor, int mode, uint64_t group_len,
+		uint64_t *high, uint8_t *level)
+{
+	uint64_t n, k, len, count, run;
+
+	memset(out, 0, sizeof(uint64_t) *
+			((chunk->num_samples / factor + 1 + 63) / 64));
+
+	len = group_len;
+	count = *high;
+	run = 0;
+	for (n = 0, k = 0; n < chunk->num_samples; ) {
+		len = MIN(factor - (chunk->start_samplenum + n) % factor,
+				chunk->num_samples - n);
+		count += chunk_count_high(chunk, probe, n, n + len, &run);
+		n += len;
+		len += group_len;
+		if ((chunk->start_samplenum + n) % factor)
+			break;
+
+		/* A group is complete. */
+		if (*level > 1)
+			*level = count * 2 >= len;
+		else if (mode == SRD_DECIMATE_EDGES)
+			*level ^= *level ? count < len : count > 0;
+		else if (count * 2 != len)
+			*level = count * 2 > len;
+		if (*level)
+			out[k / 64] |= 1ULL << (k % 64);
+		k++;
+		count = 0;
+		group_len = 0;
+		len = 0;
+	}
+	*high = count;
+
+	return len;
+}
+
+/**
+ * Expand samples start up to start + len of one probe of a chunk into an
+ * array with one byte per sample, which is 0 or 1.
+ *
+ * @param out The array to fill, with room for len samples.
+ * @param chunk The chunk to expand.
+ * @param probe The probe to expand.
+ * @param start The first sample to expand.
+ * @param len The number of samples to expand.
+ *
+ * @private
+ */
+SRD_PRIV void srd_chunk_probe_bytes(uint8_t *out, const struct srd_chunk *chunk,
+		int probe, uint64_t start, uint64_t len)
+{
+	const uint64_t *plane;
+	uint64_t lo, hi, r, n, end, x;
+
+	if (chunk->format == SRD_CHUNK_RUNS) {
+		/* Find the run holding the first sample. */
+		lo = 0;
+		hi = chunk->num_runs - 1;
+		while (lo < hi) {
+			r = lo + (hi - lo + 1) / 2;
+			if (chunk->run_starts[r] <= start)
+				lo = r;
+			else
+				hi = r - 1;
+		}
+		for (r = lo, n = start; n < start + len; r++, n = end) {
+			end = r + 1 < chunk->num_runs ?
+				chunk->run_starts[r + 1] : chunk->num_samples;
+			end = MIN(end, start + len);
+			memset(out + n - start, srd_chunk_bit(chunk, probe, n, r),
+					end - n);
+		}
+		return;
+	}
+
+	plane = chunk->planes[probe];
+	for (n = 0; n + 8 <= len; n += 8) {
+		/* Spread 8 bits out to the lowest bit of 8 bytes. */
+		x = plane[(start + n) / 64] >> ((start + n) % 64);
+		if ((start + n) % 64 > 56)
+			x |= plane[(start + n) / 64 + 1] <<
+				(64 - (start + n) % 64);
+		x &= 0xff;
+		x = (x | x << 28) & 0x0000000f0000000fULL;
+		x = (x | x << 14) & 0x0003000300030003ULL;
+		x = (x | x << 7) & 0x0101010101010101ULL;
+		x = GUINT64_TO_LE(x);
+		memcpy(out + n, &x, 8);
+	}
+	for (; n < len; n++)
+		out[n] = (plane[(start + n) / 64] >> ((start + n) % 64)) & 1;
+}
+
+/**
+ * List the changes of a probe within a chunk.
+ *
+ * A change is a sample which differs from the one before it. For the first
+ * sample of the chunk, that is the last sample of the previous chunk, as
+ * recorded in the chunk's prev_bits.
+ *
+ * @param edges The array to fill with the sample numbers of the changes,
+ *              in ascending order, or NULL to only count them.
+ * @param chunk The chunk to search.
+ * @param probe The probe to search.
+ *
+ * @return The number of changes.
+ *
+ * @private
+ */
+SRD_PRIV uint64_t srd_find_edges(uint64_t *edges, const struct srd_chunk *chunk,
+		int probe)
+{
+	const uint64_t *plane;
+	uint64_t num_edges, words, w, x, carry, r;
+	unsigned int prev, cur;
+
+	num_edges = 0;
+	prev = chunk->prev_bits[probe] & 1;
+
+	if (chunk->format == SRD_CHUNK_RUNS) {
+		for (r = 0; r < chunk->num_runs; r++) {
+			cur = srd_chunk_bit(chunk, probe, chunk->run_starts[r], r);
+			if (cur != prev) {
+				if (edges)
+					edges[num_edges] = chunk->start_samplenum +
+						chunk->run_starts[r];
+				num_edges++;
+			}
+			prev = cur;
+		}
+		return num_edges;
+	}
+
+	plane = chunk->planes[probe];
+	words = (chunk->num_samples + 63) / 64;
+	carry = prev;
+	for (w = 0; w < words; w++) {
+		/* Bit n is set if sample n differs from sample n - 1. */
+		x = plane[w] ^ (plane[w] << 1 | carry);
+		carry = plane[w] >> 63;
+		if (chunk->num_samples - w * 64 < 64)
+			x &= ~(~0ULL << (chunk->num_samples - w * 64));
+		if (!edges) {
+			num_edges += __builtin_popcountll(x);
+			continue;
+		}
+		for (; x; x &= x - 1)
+			edges[num_edges++] = chunk->start_samplenum + w * 64 +
+					__builtin_ctzll(x);
+	}
+
+	return num_edges;
+}